@@ -2,8 +2,8 @@
  * @file bluetooth.h
  * @author José Ángel Sánchez (https://github.com/gelanchez)
  * @brief Library for receiving and processing the data from the serial bluetooth JSON.
- * @version 1.2.0
- * @date 2022-04-18
+ * @version 1.3.0
+ * @date 2026-10-19
  * @copyright GPL-3.0
  */
 
@@ -13,23 +13,84 @@
 #include <ArduinoJson.h>
 #include "constants.h"
 
+/**
+ * @brief Rolling link-quality statistics.
+ */
+struct LinkStats
+{
+    unsigned short gapAverage;  // Inter-frame gap (ms)
+    unsigned short gapMax;      // Maximum inter-frame gap (ms)
+    unsigned short rttAverage;  // Round-trip time reported by the host (ms)
+    unsigned short rttMax;      // Maximum round-trip time reported by the host (ms)
+    unsigned short drainMax;    // Maximum time between drains, waiting time of the received bytes (ms)
+    unsigned short rxOverflows; // Times the serial RX buffer was found full
+};
+
 class Bluetooth
 {
 private:
-    String m_data;
+    static constexpr unsigned char s_frameSize{64}; // Maximum JSON frame length
+    char m_frame[s_frameSize];                      // Frame being received, kept between loops
+    unsigned char m_frameLength;
+    static constexpr unsigned char s_vectorHeader{0xA5}; // Binary vector frame: header, linear, angular, checksum
+    static constexpr unsigned char s_vectorSize{4};
+    unsigned char m_vectorFrame[s_vectorSize];           // Binary frame being received
+    unsigned char m_vectorLength;
     StaticJsonDocument<150> m_elegooDoc;
     RobotMode m_mode;
     Order m_order;
     unsigned short m_speed;
+    signed char m_linear, m_angular; // Order::VECTOR velocities
+    Order m_nextOrder;     // Order received after a STOP or a mode change, applied in the next drain
+    unsigned short m_nextSpeed;
+    signed char m_nextLinear, m_nextAngular;
+    bool m_deferredOrder;  // m_nextOrder pending
+    bool m_newOrder;       // Order received in the current drain
+    bool m_stopReceived;   // STOP received in the current drain
+    bool m_modeChanged;    // Mode changed in the current drain
+    bool m_mapRequest;     // Obstacle map report requested, answered by the robot
+    bool m_mapClear;       // Forget the obstacles after the report
+    bool m_lapRequest;     // Lap statistics requested, answered by the robot
+    bool m_lapReset;       // Forget the laps after the report
+    bool m_batteryRequest; // Battery state requested, answered by the robot
+    unsigned short m_receivedFrames, m_coalescedFrames, m_droppedFrames, m_malformedFrames;
+    LinkStats m_linkStats;
+    unsigned long m_frameTime;     // Time the last frame was received (us)
+    unsigned long m_lastFrameTime; // Time the previous frame was received (us)
+    unsigned long m_lastDrainTime; // Time of the previous drain (us)
+    static constexpr unsigned char s_statsShift{3}; // Rolling averages weight 1/8
+
+protected:
+    void changeMode(RobotMode mode);
+    void countFrame();
+    void decodeElegooJSON();
+    void decodeVector();
+    void setOrder(Order order, unsigned short speed, signed char linear = 0, signed char angular = 0);
+    void replyPing(unsigned long sequence, unsigned long drainGap);
+    void replyStats() const;
+    void replyTickStats() const;
+    void replyParameter(unsigned char index, bool valid) const;
+    void replyRoute(bool valid) const;
+    void updateStats(unsigned short &average, unsigned short &maximum, unsigned long value);
 
 public:
     Bluetooth();
     ~Bluetooth();
-    void decodeElegooJSON();
-    String getData() const;
     RobotMode getMode() const;
+    void setMode(RobotMode mode);
+    bool takeMapRequest(bool &clear);
+    bool takeLapRequest(bool &reset);
+    bool takeBatteryRequest();
     Order getOrder() const;
     unsigned short getSpeed() const;
+    signed char getLinear() const;
+    signed char getAngular() const;
+    unsigned short getReceivedFrames() const;
+    unsigned short getCoalescedFrames() const;
+    unsigned short getDroppedFrames() const;
+    unsigned short getMalformedFrames() const;
+    const LinkStats &getLinkStats() const;
+    void resetStats();
     void receiveData();
 };
 
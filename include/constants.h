@@ -36,8 +36,17 @@ namespace Pins
     constexpr unsigned char echoPin{A4};    // Pin 18
     constexpr unsigned char triggerPin{A5}; // Pin 19
 
+    // Fixed side ultrasonic sensors (Constants::sideSonars), echo pins in port C
+    constexpr unsigned char rightTriggerPin{13};
+    constexpr unsigned char rightEchoPin{A0};
+    constexpr unsigned char leftTriggerPin{A1};
+    constexpr unsigned char leftEchoPin{A2};
+
     // Infrared
     constexpr unsigned char IRPin{12};
+
+    // Battery voltage divider
+    constexpr unsigned char batteryPin{A3};
 }
 
 namespace Constants
@@ -49,6 +58,7 @@ namespace Constants
     // Motors min speed (measured)
     constexpr unsigned char crankSpeed{140}; // Around 120 @ full battery
     constexpr unsigned char idleSpeed{90};
+    constexpr unsigned char pwmFrequency{2}; // PwmFrequency index (motors.h): 976 Hz
 
     // Default speeds
     constexpr unsigned char linearSpeed{170};
@@ -56,18 +66,43 @@ namespace Constants
     constexpr unsigned short rotate90Time{650};   // Time to rotate 90 deg @ linearSpeed @ full battery
     constexpr unsigned short rotate180Time{1200}; // Time to rotate 180 deg @ rotateSpeed @ full battery
 
+    constexpr unsigned char fullSpeed{60};        // Approximate speed @ 255 (cm/s)
+
     // Obstacle avoidance
     constexpr unsigned short updateInterval{250}; // Default update time for states
     constexpr unsigned short minDistance{30};
+    constexpr unsigned short steerDistance{60};   // Distance from which obstacles bend the path
+    constexpr unsigned short criticalTime{400};   // Time to collision stopping the robot
+    constexpr unsigned char steerInterval{50};    // Time between steering updates
+    constexpr unsigned short stopMargin{10};      // Distance to the obstacle in front once stopped
+    constexpr unsigned short brakeDeceleration{150}; // Deceleration once the motors are stopped (cm/s2)
+    constexpr unsigned short governorReaction{100};  // Time from a ping to the motors braking (ms)
+    constexpr unsigned short speedRamp{400};      // Speed increase per second when the path clears (PWM)
+    constexpr unsigned char mapGate{15};          // Maximum difference between a ping and the known obstacle to correct the position (cm)
+    constexpr unsigned char mapCorrection{30};    // Part of that difference corrected (%)
 
     // Line tracking
     constexpr unsigned short minDetourDistance{10}; // Distance to keep with the obstacle
     constexpr unsigned short updateUltrasonicInterval{20};
     constexpr unsigned short extraTime{100};      // Extra time to keep moving the robot to pass the object
     constexpr unsigned short extraTimeLine{50};   // Extra time to pass the line
-    constexpr unsigned short timeUntilLost{1000}; // Wait time until LOSTLINE and turn back
-    constexpr unsigned short timeLost{5000};      // Time lost to find a new line
+    constexpr unsigned short timeUntilLost{100};  // Time without line, keeping the last correction, until LINELOST
+    constexpr unsigned short lineGapTime{300};    // Time moving forward to jump a gap when the line was lost in front
+    constexpr unsigned short lineSearchDistance{200}; // Distance to travel searching for the line before giving up (cm)
+    constexpr unsigned char lineSearchSpeed{40};  // Approximate speed @ linearSpeed to estimate the searched distance (cm/s)
+    constexpr signed char lineBiasMax{8};         // Limit of the left/right corrections history
+    constexpr unsigned short lapMinTime{3000};    // Minimum lap time, ignores the same start/finish marker crossed again
+    constexpr unsigned char lapHistory{4};        // Recent laps kept for the report
+    constexpr unsigned short controlTickPeriod{2000}; // Line follower control tick (us): 500 Hz
+    constexpr unsigned char junctionTime{60};     // Maximum time an outer sensor crosses a branch, longer is a curve
+    constexpr unsigned char junctionMinTime{20};  // Minimum time an outer sensor sees a branch, shorter is a graze of the line
+    constexpr unsigned char junctionOvershoot{120}; // Time forward from the junction to the wheels over it before turning
+    // The junction times above are at linearSpeed, the line follower scales them by the commanded speed
     constexpr unsigned char marginObject{1};      // Margin +- distance to the object
+    constexpr unsigned char detourKp{12};         // Proportional gain going around the object (PWM per cm)
+    constexpr unsigned char detourKd{40};         // Derivative gain going around the object (PWM per cm and ping)
+    constexpr unsigned char cornerDistance{15};   // Predicted distance jump meaning the end of the object side
+    constexpr unsigned char cornerRatio{60};      // Inner wheel speed (%) while turning around the object corner
 
     // Park mode
     constexpr unsigned short timeMoving{500};
@@ -80,9 +115,36 @@ namespace Constants
     // Ultrasonic sensor
     constexpr unsigned short maxDistance{250};             // Maximun distance to meassure in cm
     constexpr unsigned short maxDistanceLineTracking{100}; // Maximun distance to meassure in cm used in the linetraking mode
+    constexpr bool sideSonars{false};                      // Fixed sensors on both sides, see Pins
+    constexpr unsigned char sonarQuietTime{10};            // Time between side pings for the echoes to fade away
+
+    // Obstacle avoidance
+    constexpr unsigned short escapeMemoryTime{30000}; // Time until an escape turn is forgotten
 
     // Infrared
     constexpr unsigned short IRMovingInterval{100}; // Default time for moving in IR
+
+    // Remote control
+    constexpr unsigned short idleTimeout{10000}; // Time stopped until sleeping
+
+    // Battery: 2 Li-ion cells through a 10k/1.5k divider
+    constexpr unsigned short batteryCountVoltage{37440}; // Battery voltage per ADC count (uV)
+    constexpr unsigned short batteryInterval{1000};      // Time between samples
+    constexpr unsigned short batteryNominal{8000};       // Voltage of the speeds and times measured "@ full battery" (mV)
+    constexpr unsigned short batteryWeak{7000};          // Compensation near its limit (mV)
+    constexpr unsigned short batteryCritical{6400};      // Autonomous modes stop to protect the cells (mV)
+    constexpr unsigned short maxVoltageScale{384};       // Maximum compensation, nominal / battery voltage: 1.5
+
+    // Calibration mode
+    constexpr unsigned char calibrationStep{5};           // PWM step of the speed ramps
+    constexpr unsigned short calibrationStepTime{200};    // Time at each PWM step
+    constexpr unsigned char calibrationMargin{5};         // PWM added to the measured minimum speeds
+    constexpr unsigned char calibrationMoved{2};          // Distance change meaning the robot moves (cm)
+    constexpr unsigned char calibrationThreshold{5};      // Distance change confirming a minimum of the rotation profile (cm)
+    constexpr unsigned short calibrationTimeout{10000};   // Maximum time rotating
+    constexpr unsigned short calibrationServoRange{150};  // Servo sweep around the center (us)
+    constexpr unsigned char calibrationServoStep{10};     // Servo sweep step (us)
+    constexpr unsigned char calibrationPingPeriod{60};    // Minimum time between pings, for the late echoes to fade away
 }
 
 /**
@@ -96,6 +158,7 @@ enum class RobotMode
     LINETRACKING,
     PARK,
     CUSTOM,
+    CALIBRATION,
 };
 
 /**
@@ -112,6 +175,7 @@ enum class Order
     BACKWARD_LEFT,
     FORWARD_RIGHT,
     BACKWARD_RIGHT,
+    VECTOR, // Linear and angular velocity
     UNKNOWN,
 };
 
@@ -128,4 +192,28 @@ enum class RobotModeState
     LINELOST, // Only used in linetracking
 };
 
+/**
+ * @brief Phases of the line search in LINELOST.
+ */
+enum class SearchPhase
+{
+    GAP,       // Keep forward, the line was lost in front
+    SWEEP,     // Rotate towards the likely side
+    SWEEPBACK, // Rotate towards the other side
+    SPIRAL,    // Expanding arc towards the likely side
+};
+
+/**
+ * @brief Phases of the junction handling of the line follower tick.
+ */
+enum class JunctionPhase : unsigned char
+{
+    NONE,      // Following the line
+    CROSSING,  // Outer sensors over a branch, going straight
+    CURVE,     // Not a junction, wait for the outer sensors to leave the line
+    OVERSHOOT, // Forward until the wheels are over the junction
+    LEAVE,     // Rotate off the current line
+    FIND,      // Rotate onto the branch
+};
+
 #endif
\ No newline at end of file
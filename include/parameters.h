@@ -0,0 +1,97 @@
+/**
+ * @file parameters.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Runtime tuning parameters stored in EEPROM, with the constants as defaults.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+/**
+ * @brief Tuning parameters. The value is the index in the registry, don't reorder without
+ * increasing Parameters::s_version.
+ */
+enum class Param : unsigned char
+{
+    crankSpeed,
+    idleSpeed,
+    linearSpeed,
+    rotateSpeed,
+    rotate90Time,
+    rotate180Time,
+    updateInterval,
+    minDistance,
+    minDetourDistance,
+    updateUltrasonicInterval,
+    extraTimeLine,
+    timeUntilLost,
+    lineGapTime,
+    lineSearchDistance,
+    lineSearchSpeed,
+    marginObject,
+    detourKp,
+    detourKd,
+    cornerDistance,
+    cornerRatio,
+    timeMoving,
+    timeMoveAway,
+    servo0,
+    servo180,
+    IRMovingInterval,
+    idleTimeout,
+    pwmFrequency,
+    steerDistance,
+    criticalTime,
+    stopMargin,
+    count, // Number of parameters
+};
+
+/**
+ * @brief Parameter description: default value and valid range.
+ */
+struct ParamInfo
+{
+    unsigned short defaultValue;
+    unsigned short minValue;
+    unsigned short maxValue;
+};
+
+class Parameters
+{
+public:
+    static constexpr unsigned char s_count{static_cast<unsigned char>(Param::count)};
+    static constexpr int s_address{0}; // EEPROM address of the header, then the CRC and the values
+
+private:
+    static constexpr unsigned char s_version{1}; // EEPROM layout version
+    static const ParamInfo s_info[s_count]; // In PROGMEM
+    static unsigned short s_values[s_count];
+    static unsigned char s_revision; // Increased on every change
+
+    static unsigned short crc(unsigned short crc, const unsigned char *data, size_t length);
+
+public:
+    /**
+     * @brief Read a parameter. Inline, with a constant index it is a plain RAM read.
+     * @param param Parameter.
+     * @return unsigned short Value.
+     */
+    static unsigned short get(Param param)
+    {
+        return s_values[static_cast<unsigned char>(param)];
+    }
+    static unsigned char getRevision();
+    static ParamInfo getInfo(Param param);
+    static bool set(Param param, unsigned short value);
+    static bool load();
+    static void save();
+    static void reset();
+};
+
+#endif
\ No newline at end of file
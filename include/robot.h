@@ -11,13 +11,88 @@
 #define ROBOT_H
 
 #include <Arduino.h>
+#include "battery.h"
 #include "constants.h"
+#include "controltick.h"
+#include "escapememory.h"
 #include "infrared.h"
 #include "linetracking.h"
 #include "motors.h"
 #include "myservo.h"
+#include "obstaclegrid.h"
+#include "odometry.h"
+#include "parameters.h"
+#include "rangeestimator.h"
+#include "routes.h"
+#include "speedgovernor.h"
+#include "spscqueue.h"
 #include "ultrasonic.h"
 
+/**
+ * @brief Sensor readings of one loop, taken once by Robot::acquireSensors() or given by
+ * Robot::setSnapshot(), and only read by the modes.
+ */
+struct SensorSnapshot
+{
+    unsigned long time;          // Acquisition time (ms)
+    unsigned char lines;         // Line sensors: LineTracking::s_left | s_mid | s_right
+    unsigned short distance;     // Last sonar distance (cm)
+    unsigned char sonarAngle;    // Servo angle of the last ping
+    unsigned long sonarTime;     // Time of the last ping (ms), its age is time - sonarTime
+    bool sonarNew;               // Ping taken in this acquisition
+    unsigned char servoAngle;    // Servo position
+    short leftSpeed, rightSpeed; // Motors speeds commanded
+    unsigned short sideDistances[2]; // Fixed side sonars: right (0 deg) and left (180 deg)
+    unsigned long sideTimes[2];      // Time of the side distances (ms)
+    unsigned char sidesNew;          // Bit per side sonar, distance received in this acquisition
+    unsigned short voltage;          // Battery, filtered (mV)
+};
+
+/**
+ * @brief Line tracking statistics of a lap between two crossings of the start/finish marker.
+ */
+struct LapStats
+{
+    unsigned long time;          // Lap time (ms)
+    unsigned short corrections;  // Outer sensor corrections
+    unsigned long lostTime;      // Time searching for the lost line (ms)
+    unsigned long obstacleTime;  // Time going around obstacles (ms)
+    unsigned char minSpeed, maxSpeed; // Line following speeds commanded
+};
+
+/**
+ * @brief Line follower commands from the main program to the control tick.
+ */
+enum class LineCommandType : unsigned char
+{
+    START, // Take the motors and follow the line
+    SPEED, // Change the speeds only
+    STOP,  // Release the motors
+    RESET, // Release the motors and clear the corrections history
+};
+
+struct LineCommand
+{
+    LineCommandType type;
+    unsigned char speed;       // Forward speed
+    unsigned char rotateSpeed; // Correction speed
+    unsigned short lostTicks;  // Ticks without line, keeping the last correction, until lost
+    unsigned short turnTicks;  // Ticks rotating at a junction to find the branch, until lost
+    unsigned short crossingTicks;  // Constants::junctionTime at the speed
+    unsigned short branchTicks;    // Constants::junctionMinTime at the speed
+    unsigned short overshootTicks; // Constants::junctionOvershoot at the speed
+};
+
+/**
+ * @brief Line lost or route end report from the control tick to the main program, which takes the motors back.
+ */
+struct LineEvent
+{
+    bool searchLeft;  // Likely side of the lost line
+    bool lostInFront; // Lost moving forward, not correcting
+    bool routeEnd;    // End of the route reached, stopped
+};
+
 class Robot
 {
 private:
@@ -25,17 +100,85 @@ private:
     MyServo m_servo;
     Ultrasonic m_ultrasonic;
     LineTracking m_lineTracking;
+    Battery m_battery;
+    BatteryLevel m_batteryLevel;
+    SensorSnapshot m_snapshot;
+    unsigned long m_lastPing;
+    unsigned short m_pingInterval;    // Time between pings taken by acquireSensors(), 0 for none
+    unsigned short m_pingMaxDistance;
     unsigned short m_sonarMap[5];
+    RangeEstimator m_rangeEstimators[5]; // Estimators of the m_sonarMap directions
+    Odometry m_odometry;                 // Pose from the mode start
+    ObstacleGrid m_obstacleGrid;         // Obstacles found, kept between runs
+    EscapeMemory m_escapes;              // Recent escape turns, from the mode start
+    SpeedGovernor m_governor;            // Forward speed limit from the front estimator
+    unsigned short m_scans;              // Stops to scan around since the mode start
     RobotModeState m_state;        // State of the RobotMode
     unsigned char m_previousAngle; // Previous angle of the servo
     unsigned long m_lastUpdate;
     unsigned short m_interval;
+    unsigned long m_lastSteer;
+    short m_detourError;  // Previous distance error going around the object
+    bool m_detourCorner;  // Turning around the object corner
+    SpscQueue<LineCommand, 4> m_lineCommands; // Main program to control tick
+    SpscQueue<LineEvent, 4> m_lineEvents;     // Control tick to main program
+    SpscQueue<unsigned long, 4> m_lapMarkers; // Control tick to main program: tick of each start/finish marker crossing
+    LineCommand m_lineFollower;   // Control tick only: current command
+    unsigned short m_lineLostTicks; // Control tick only: ticks without line
+    signed char m_lineBias;       // Control tick only: history of line corrections, positive left
+    bool m_lineLeft;              // Control tick only: side of the last correction
+    JunctionPhase m_junctionPhase; // Control tick only
+    unsigned char m_junctionWays;  // Control tick only: branches seen, LineTracking bits, s_mid for straight on
+    unsigned short m_junctionTicks; // Control tick only: ticks in the junction phase
+    bool m_junctionLeft;           // Control tick only: side of the junction turn
+    unsigned char m_branchTicks[2]; // Control tick only: ticks the left and right sensors saw a branch, up to branchTicks
+    bool m_lineMarker;             // Control tick only: all the line sensors on the start/finish marker
+    unsigned long m_ticks;         // Control tick only: ticks since start
+    volatile unsigned char m_junctions; // Junctions passed since the mode start, index of the route
+    volatile unsigned short m_lineCorrections; // Outer sensor corrections, counted by the control tick
+    LapStats m_lap;                  // Current lap
+    LapStats m_recentLaps[Constants::lapHistory]; // Last completed laps, ring
+    unsigned long m_bestLap;         // Best lap time, 0 for none
+    unsigned short m_laps;           // Completed laps, the last one in m_recentLaps[(m_laps - 1) % Constants::lapHistory]
+    bool m_lapRunning;               // Start/finish marker crossed in this run
+    unsigned long m_lapStart;        // Control tick of the marker crossing which started the current lap
+    unsigned long m_lapClock;        // Time of the last lap update
+    bool m_searchLeft;            // Likely side of the lost line
+    SearchPhase m_searchPhase;
+    unsigned short m_searchDistance; // Distance travelled searching for the line (cm)
+    bool m_idle;                     // Servo detached, motors off and sleeping between commands
 
 protected:
     void speedControl();
     unsigned char mapAngle(unsigned char angle) const;
+    void setState(RobotModeState state);
+    void setSonar(unsigned short interval, unsigned short maxDistance);
+    unsigned short ping(unsigned short maxDistance);
+    void compensateBattery();
+    float commandedRate(unsigned char index) const;
+    float frontApproach() const;
+    void updateSonarMap();
+    void resetSonarMap(unsigned char index);
     void moveServoSequence();
-    unsigned char calculateSpeed(unsigned short distance, unsigned short minDistance = Constants::minDistance, unsigned short maxDistance = Constants::maxDistance, unsigned char minSpeed = Constants::crankSpeed) const;
+    bool steerControl();
+    void mapReading(unsigned char angle, unsigned short distance);
+    void detourControl(unsigned short distance);
+    static void controlTick(void *robot);
+    void lineFollowerTick();
+    bool junctionTick(unsigned char lines);
+    bool takeJunction();
+    void followLine(LineCommandType type, unsigned char speed = 0);
+    static unsigned short junctionTicks(unsigned char time, unsigned char speed);
+    void startLineSearch(const LineEvent &event);
+    void startLap(unsigned long tick);
+    void updateLap();
+    void idleControl();
+    void wakeUp();
+    unsigned short pingMedian(unsigned short maxDistance);
+    unsigned short pingSpaced(unsigned short maxDistance);
+    bool calibrateServo(unsigned int &servo0, unsigned int &servo180);
+    bool calibrateRotation(unsigned short &rotate90Time, unsigned short &rotate180Time);
+    bool calibrateSpeeds(unsigned char &crankSpeed, unsigned char &idleSpeed);
 
 public:
     Infrared m_infrared; // Member variable as public to enable from main
@@ -43,12 +186,23 @@ public:
     ~Robot();
     void restartState();
     void begin();
-    void remoteControlMode(Order order, unsigned char linearSpeed = Constants::linearSpeed, unsigned char rotateSpeed = Constants::rotateSpeed);
-    void IRControlMode(unsigned char linearSpeed = Constants::linearSpeed, unsigned char rotateSpeed = Constants::rotateSpeed);
+    void acquireSensors();
+    void setSnapshot(const SensorSnapshot &snapshot);
+    const SensorSnapshot &getSnapshot() const;
+    unsigned short getScans() const;
+    BatteryLevel getBatteryLevel() const;
+    void applyParameters();
+    void remoteControlMode(Order order, unsigned char linearSpeed = Parameters::get(Param::linearSpeed), unsigned char rotateSpeed = Parameters::get(Param::rotateSpeed));
+    void remoteVectorMode(signed char linear, signed char angular);
+    void IRControlMode(unsigned char linearSpeed = Parameters::get(Param::linearSpeed), unsigned char rotateSpeed = Parameters::get(Param::rotateSpeed));
     void obstacleAvoidanceMode();
     void lineTrackingMode();
     void parkMode();
     void customMode();
+    void calibrationMode();
+    void replyMap(bool clear);
+    void replyLaps(bool reset);
+    void replyBattery() const;
 };
 
 #endif
\ No newline at end of file
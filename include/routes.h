@@ -0,0 +1,55 @@
+/**
+ * @file routes.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Route table of the line tracking mode: the turn to take at each junction, stored in EEPROM.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef ROUTES_H
+#define ROUTES_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Turn at a junction, sent and reported as its letter.
+ */
+enum class Turn : unsigned char
+{
+    STRAIGHT = 'S',
+    LEFT = 'L',
+    RIGHT = 'R',
+    STOP = 'E', // End of the route
+};
+
+class Routes
+{
+public:
+    static constexpr int s_address{128}; // EEPROM address of the header, after the parameters
+
+private:
+    static constexpr unsigned char s_size{32};    // Maximum junctions
+    static constexpr unsigned char s_version{1};  // EEPROM layout version
+    static Turn s_turns[s_size];
+    static unsigned char s_length;
+
+    static unsigned short crc(unsigned char length, const Turn *turns);
+
+public:
+    /**
+     * @brief Read the turn of a junction, also from the control tick.
+     * @param junction Junction index from the start of the run.
+     * @return Turn Turn, straight after the end of the table.
+     */
+    static Turn get(unsigned char junction)
+    {
+        return (junction < s_length) ? s_turns[junction] : Turn::STRAIGHT;
+    }
+    static unsigned char getLength();
+    static bool set(unsigned char junction, const char *turns);
+    static bool load();
+    static void save();
+};
+
+#endif
\ No newline at end of file
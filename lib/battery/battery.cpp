@@ -0,0 +1,81 @@
+/**
+ * @file battery.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Battery voltage sampled at a low rate through a resistor divider.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "battery.h"
+
+/**
+ * @brief Construct a new Battery::Battery object.
+ * @param pin Analog pin of the divider output.
+ * @param countVoltage Battery voltage per ADC count (uV), 5 V reference.
+ * @param interval Time between samples (ms).
+ */
+Battery::Battery(unsigned char pin, unsigned short countVoltage, unsigned short interval)
+    : m_pin{pin}, m_countVoltage{countVoltage}, m_interval{interval}, m_lastSample{0}, m_voltage{0}
+{
+}
+
+/**
+ * @brief Destroy the Battery::Battery object.
+ */
+Battery::~Battery()
+{
+}
+
+/**
+ * @brief Take the first sample, without filtering.
+ */
+void Battery::begin()
+{
+    pinMode(m_pin, INPUT);
+    m_voltage = static_cast<unsigned long>(analogRead(m_pin)) * m_countVoltage / 1000;
+}
+
+/**
+ * @brief Sample the voltage once every interval. The motors current makes it drop, the samples are
+ * low-pass filtered.
+ * @param time Current time (ms).
+ * @return true New sample taken.
+ * @return false Interval not elapsed.
+ */
+bool Battery::update(unsigned long time)
+{
+    if ((time - m_lastSample) < m_interval)
+        return false;
+    m_lastSample = time;
+    long voltage = static_cast<long>(analogRead(m_pin)) * m_countVoltage / 1000; // 100 us
+    m_voltage += (voltage - static_cast<long>(m_voltage)) >> s_filterShift;
+    return true;
+}
+
+/**
+ * @brief Get the filtered voltage.
+ * @return unsigned short Voltage (mV).
+ */
+unsigned short Battery::getVoltage() const
+{
+    return m_voltage;
+}
+
+/**
+ * @brief Get the charge level.
+ * @param lowVoltage Voltage below which the level is WEAK (mV).
+ * @param criticalVoltage Voltage below which the level is CRITICAL (mV).
+ * @return BatteryLevel Level.
+ */
+BatteryLevel Battery::getLevel(unsigned short lowVoltage, unsigned short criticalVoltage) const
+{
+    if (m_voltage < s_noBattery)
+        return BatteryLevel::NONE;
+    if (m_voltage < criticalVoltage)
+        return BatteryLevel::CRITICAL;
+    if (m_voltage < lowVoltage)
+        return BatteryLevel::WEAK;
+    return BatteryLevel::GOOD;
+}
\ No newline at end of file
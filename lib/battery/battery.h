@@ -0,0 +1,46 @@
+/**
+ * @file battery.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Battery voltage sampled at a low rate through a resistor divider.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Battery charge levels.
+ */
+enum class BatteryLevel : unsigned char
+{
+    NONE,     // No battery, e.g. powered by USB
+    GOOD,
+    WEAK,     // Compensation near its limit
+    CRITICAL, // Stop draining the battery
+};
+
+class Battery
+{
+private:
+    unsigned char m_pin;           // Divider output pin
+    unsigned short m_countVoltage; // Battery voltage per ADC count (uV)
+    unsigned short m_interval;     // Time between samples (ms)
+    unsigned long m_lastSample;
+    unsigned short m_voltage;      // Filtered voltage (mV)
+    static constexpr unsigned char s_filterShift{2};    // Filter weight of a new sample: 1/4
+    static constexpr unsigned short s_noBattery{3000};  // Lower voltages are not a battery (mV)
+
+public:
+    Battery(unsigned char pin, unsigned short countVoltage, unsigned short interval);
+    ~Battery();
+    void begin();
+    bool update(unsigned long time);
+    unsigned short getVoltage() const;
+    BatteryLevel getLevel(unsigned short lowVoltage, unsigned short criticalVoltage) const;
+};
+
+#endif
\ No newline at end of file
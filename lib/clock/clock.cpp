@@ -0,0 +1,105 @@
+/**
+ * @file clock.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief System tick independent of the Timer0 configuration, to replace millis(), micros() and delay().
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "clock.h"
+
+unsigned int Clock::s_numerator{1};
+unsigned int Clock::s_denominator{1};
+unsigned long Clock::s_lastMillis{0};
+unsigned long Clock::s_millis{0};
+unsigned int Clock::s_millisRemainder{0};
+unsigned long Clock::s_lastMicros{0};
+unsigned long Clock::s_micros{0};
+unsigned int Clock::s_microsRemainder{0};
+
+/**
+ * @brief Convert the core time elapsed since the last call into real time, keeping the remainder.
+ * @param coreTime Current core time.
+ * @param lastCoreTime Core time of the last call, updated.
+ * @param remainder Remainder of the last conversion, updated.
+ * @return unsigned long Real time elapsed.
+ */
+unsigned long Clock::scale(unsigned long coreTime, unsigned long &lastCoreTime, unsigned int &remainder)
+{
+    unsigned long delta = coreTime - lastCoreTime;
+    if (delta > 0x80000000UL) // Core micros() goes back within a period in phase correct PWM
+        return 0;
+    lastCoreTime = coreTime;
+    unsigned long elapsed{0};
+    while (delta > 0) // Chunks small enough not to overflow the product
+    {
+        unsigned long chunk = (delta > 0xFFFFUL) ? 0xFFFFUL : delta;
+        delta -= chunk;
+        unsigned long product = chunk * s_denominator + remainder;
+        elapsed += product / s_numerator;
+        remainder = product % s_numerator;
+    }
+    return elapsed;
+}
+
+/**
+ * @brief Milliseconds since start, correct whatever the Timer0 prescaler. Not for interrupts.
+ * Its resolution is the core millis() one scaled, e.g. 16 ms with Timer0 at 61 Hz.
+ * @return unsigned long Milliseconds.
+ */
+unsigned long Clock::millis()
+{
+    s_millis += scale(::millis(), s_lastMillis, s_millisRemainder);
+    return s_millis;
+}
+
+/**
+ * @brief Microseconds since start, correct whatever the Timer0 prescaler. Not for interrupts.
+ * It must be called at least once every 71 min of core time (core micros() overflow).
+ * @return unsigned long Microseconds.
+ */
+unsigned long Clock::micros()
+{
+    s_micros += scale(::micros(), s_lastMicros, s_microsRemainder);
+    return s_micros;
+}
+
+/**
+ * @brief Wait a number of milliseconds.
+ * @param ms Milliseconds.
+ */
+void Clock::delay(unsigned long ms)
+{
+    unsigned long start = millis();
+    while ((millis() - start) < ms)
+        ;
+}
+
+/**
+ * @brief Set how fast the core time runs compared to real time, after changing the Timer0 prescaler
+ * or mode. The time elapsed until now is converted with the previous scale.
+ * @param numerator Core time per real time: numerator.
+ * @param denominator Core time per real time: denominator.
+ */
+void Clock::setScale(unsigned int numerator, unsigned int denominator)
+{
+    millis();
+    micros();
+    s_numerator = numerator;
+    s_denominator = denominator;
+    s_millisRemainder = 0;
+    s_microsRemainder = 0;
+}
+
+/**
+ * @brief Convert a core time interval, e.g. measured with the core millis() in an interrupt, into
+ * real time. Not for interrupts.
+ * @param coreTime Core time interval.
+ * @return unsigned long Real time interval.
+ */
+unsigned long Clock::toReal(unsigned long coreTime)
+{
+    return coreTime / s_numerator * s_denominator + coreTime % s_numerator * s_denominator / s_numerator;
+}
\ No newline at end of file
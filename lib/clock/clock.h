@@ -0,0 +1,35 @@
+/**
+ * @file clock.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief System tick independent of the Timer0 configuration, to replace millis(), micros() and delay().
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+class Clock
+{
+private:
+    static unsigned int s_numerator;     // Core time per real time: numerator
+    static unsigned int s_denominator;   // Core time per real time: denominator
+    static unsigned long s_lastMillis;   // Last core millis()
+    static unsigned long s_millis;       // Real milliseconds
+    static unsigned int s_millisRemainder;
+    static unsigned long s_lastMicros;   // Last core micros()
+    static unsigned long s_micros;       // Real microseconds
+    static unsigned int s_microsRemainder;
+
+    static unsigned long scale(unsigned long coreTime, unsigned long &lastCoreTime, unsigned int &remainder);
+
+public:
+    static unsigned long millis();
+    static unsigned long micros();
+    static void delay(unsigned long ms);
+    static void setScale(unsigned int numerator, unsigned int denominator);
+    static unsigned long toReal(unsigned long coreTime);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+/**
+ * @file controltick.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Fixed rate control tick on the Timer1 compare B interrupt, shared with the Servo library.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "controltick.h"
+
+void (*ControlTick::s_callback)(void *){nullptr};
+void *ControlTick::s_context{nullptr};
+unsigned short ControlTick::s_period{0};
+TickStats ControlTick::s_stats{0, 0, 0, 0, 0};
+
+ISR(TIMER1_COMPB_vect)
+{
+    ControlTick::run();
+}
+
+/**
+ * @brief TCNT1 period. The Servo library compare A interrupt resets TCNT1 at the end of each servo
+ * frame. Without it, servo never attached, detached with a library version which stops the interrupt,
+ * or masked while sleeping, TCNT1 runs over the full 16 bits.
+ * @return unsigned long Timer ticks.
+ */
+unsigned long ControlTick::timerPeriod()
+{
+    return (TIMSK1 & _BV(OCIE1A)) ? s_frame : s_wrap;
+}
+
+/**
+ * @brief Timer ticks from a time to another, taking into account the TCNT1 period.
+ * @param now Later time.
+ * @param from Earlier time.
+ * @return unsigned short Timer ticks.
+ */
+unsigned short ControlTick::elapsed(unsigned short now, unsigned short from)
+{
+    return (now >= from) ? (now - from) : static_cast<unsigned short>(now + timerPeriod() - from);
+}
+
+/**
+ * @brief Start calling a function at a fixed rate from the Timer1 compare B interrupt. Timer1 runs
+ * at 0.5 us ticks for the Servo library, which must be attached first; it is started the same way
+ * otherwise.
+ * @param period Period (us), below the 20 ms servo frame.
+ * @param callback Function called with interrupts disabled. It must be shorter than the period.
+ * @param context Callback argument.
+ */
+void ControlTick::begin(unsigned short period, void (*callback)(void *), void *context)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) == 0) // Timer1 stopped: normal mode, prescaler 8
+        {
+            TCCR1A = 0;
+            TCCR1B = _BV(CS11);
+        }
+        s_callback = callback;
+        s_context = context;
+        s_period = period * 2;
+        unsigned long next = static_cast<unsigned long>(TCNT1) + s_period;
+        unsigned long wrap = timerPeriod();
+        OCR1B = (next >= wrap) ? (next - wrap) : next;
+        TIFR1 = _BV(OCF1B); // Clear a pending match
+        TIMSK1 |= _BV(OCIE1B);
+    }
+    resetStats();
+}
+
+/**
+ * @brief Stop the tick.
+ */
+void ControlTick::end()
+{
+    TIMSK1 &= ~_BV(OCIE1B);
+}
+
+/**
+ * @brief Get the tick statistics.
+ * @param stats Statistics, times in us.
+ */
+void ControlTick::getStats(TickStats &stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats = s_stats;
+    }
+    stats.jitterAverage /= 2;
+    stats.jitterMax /= 2;
+    stats.durationMax /= 2;
+}
+
+/**
+ * @brief Reset the tick statistics.
+ */
+void ControlTick::resetStats()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        s_stats = TickStats{0, 0, 0, 0, 0};
+    }
+}
+
+/**
+ * @brief Run the callback, schedule the next tick and measure the delays. Called from the interrupt.
+ */
+void ControlTick::run()
+{
+    unsigned short scheduled = OCR1B;
+    unsigned short start = TCNT1;
+    unsigned short jitter = elapsed(start, scheduled);
+    if (jitter >= s_period) // Ticks missed, e.g. TCNT1 reset by a servo attach
+    {
+        ++s_stats.overruns;
+        scheduled = start;
+        jitter = 0;
+    }
+    unsigned long next = static_cast<unsigned long>(scheduled) + s_period;
+    unsigned long wrap = timerPeriod();
+    OCR1B = (next >= wrap) ? ((next - wrap < s_minCompare) ? s_minCompare : next - wrap) : next;
+
+    if (s_callback)
+        s_callback(s_context);
+
+    unsigned short duration = elapsed(TCNT1, start);
+    if ((jitter + duration) >= s_period)
+        ++s_stats.overruns;
+    ++s_stats.ticks;
+    if (jitter > s_stats.jitterMax)
+        s_stats.jitterMax = jitter;
+    if (duration > s_stats.durationMax)
+        s_stats.durationMax = duration;
+    s_stats.jitterAverage += (static_cast<short>(jitter - s_stats.jitterAverage)) >> s_jitterShift;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+/**
+ * @file controltick.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Fixed rate control tick on the Timer1 compare B interrupt, shared with the Servo library.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef CONTROLTICK_H
+#define CONTROLTICK_H
+
+#include <Arduino.h>
+
+struct TickStats
+{
+    unsigned long ticks;          // Ticks run
+    unsigned short jitterAverage; // Average delay from the scheduled time (us)
+    unsigned short jitterMax;     // Maximum delay from the scheduled time (us)
+    unsigned short durationMax;   // Maximum callback duration (us)
+    unsigned short overruns;      // Ticks missed or finished after the next scheduled time
+};
+
+class ControlTick
+{
+private:
+    static constexpr unsigned short s_frame{40000};  // Servo library refresh interval, TCNT1 is reset (timer ticks)
+    static constexpr unsigned long s_wrap{65536};    // TCNT1 period without the Servo library interrupt
+    static constexpr unsigned char s_minCompare{8}; // Compare matches right after a TCNT1 reset are blocked
+    static constexpr unsigned char s_jitterShift{3}; // Jitter average weight: 1/8
+    static void (*s_callback)(void *);
+    static void *s_context;
+    static unsigned short s_period; // Timer ticks of 0.5 us
+    static TickStats s_stats;       // In timer ticks until read
+
+    static unsigned long timerPeriod();
+
+public:
+    static unsigned short elapsed(unsigned short now, unsigned short from);
+    static void begin(unsigned short period, void (*callback)(void *), void *context);
+    static void end();
+    static void getStats(TickStats &stats);
+    static void resetStats();
+    static void run();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+/**
+ * @file escapememory.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Short-term memory of the escape turns in obstacle avoidance, to stop bouncing between the same walls.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "escapememory.h"
+
+/**
+ * @brief Construct a new EscapeMemory::EscapeMemory object.
+ * @param decay Time until a record is forgotten (ms).
+ */
+EscapeMemory::EscapeMemory(unsigned short decay)
+    : m_records{}, m_next{0}, m_count{0}, m_decay{decay}, m_loops{0}
+{
+}
+
+/**
+ * @brief Destroy the EscapeMemory::EscapeMemory object.
+ */
+EscapeMemory::~EscapeMemory()
+{
+}
+
+/**
+ * @brief Forget all the records, the headings are no longer valid.
+ */
+void EscapeMemory::clear()
+{
+    m_next = 0;
+    m_count = 0;
+    m_loops = 0;
+}
+
+/**
+ * @brief Convert the heading to 1/256 of turn, wrapping around.
+ * @param heading Heading (rad).
+ * @return signed char Heading (1/256 turn).
+ */
+signed char EscapeMemory::toHeading(float heading)
+{
+    return static_cast<signed char>(static_cast<int>(lround(heading * (128 / PI))));
+}
+
+/**
+ * @brief Return if two headings are roughly the same.
+ * @param heading1 Heading (1/256 turn).
+ * @param heading2 Heading (1/256 turn).
+ * @return true Closer than 45 deg.
+ * @return false Different headings.
+ */
+bool EscapeMemory::isNear(signed char heading1, signed char heading2)
+{
+    signed char difference = static_cast<signed char>(heading1 - heading2); // Wraps around
+    return (difference > -s_near) && (difference < s_near);
+}
+
+/**
+ * @brief Weight of a record, decaying linearly with its age.
+ * @param record Record.
+ * @param time Current time (ms).
+ * @return unsigned char 255 just recorded, 0 forgotten.
+ */
+unsigned char EscapeMemory::weight(const EscapeRecord &record, unsigned long time) const
+{
+    unsigned long age = time - record.time;
+    if (age >= m_decay)
+        return 0;
+    return static_cast<unsigned char>((m_decay - age) * 255UL / m_decay);
+}
+
+/**
+ * @brief Penalty of turning to one side: recent dead ends, stops blocked ahead and to both sides,
+ * facing the heading after the turn. Plain stops are not counted, in a corridor the robot also
+ * stops facing the way out.
+ * @param time Current time (ms).
+ * @param target Heading after the turn (1/256 turn).
+ * @return unsigned short Sum of the weights of the records against the turn.
+ */
+unsigned short EscapeMemory::penalty(unsigned long time, signed char target) const
+{
+    unsigned short penalty{0};
+    for (unsigned char i{0}; i < m_count; ++i)
+    {
+        if (m_records[i].blocked && isNear(m_records[i].heading, target))
+            penalty += weight(m_records[i], time);
+    }
+    return penalty;
+}
+
+/**
+ * @brief Return if the robot keeps stopping facing the same heading.
+ * @param time Current time (ms).
+ * @param heading Current heading (1/256 turn).
+ * @return true Loop detected.
+ * @return false Not looping.
+ */
+bool EscapeMemory::isLooping(unsigned long time, signed char heading) const
+{
+    unsigned char stops{0};
+    for (unsigned char i{0}; i < m_count; ++i)
+    {
+        if (weight(m_records[i], time) && isNear(m_records[i].heading, heading))
+            ++stops;
+    }
+    return stops >= s_loopStops;
+}
+
+/**
+ * @brief Choose the side to escape from an obstacle and remember it. The free distances are
+ * scaled down by the penalty of each side. Loops are only counted: always turning to the same
+ * side makes a U-turn back into a narrow dead end.
+ * @param time Current time (ms).
+ * @param heading Current heading (rad).
+ * @param right Free distance to the right (cm).
+ * @param left Free distance to the left (cm).
+ * @param blocked Turning 180 deg.
+ * @return true Turn left.
+ * @return false Turn right.
+ */
+bool EscapeMemory::chooseLeft(unsigned long time, float heading, unsigned short right, unsigned short left, bool blocked)
+{
+    signed char current = toHeading(heading);
+    unsigned char turn = blocked ? 128 : 64; // Headings after the turn
+    unsigned long scoreRight = static_cast<unsigned long>(right) * 256 / (256 + penalty(time, static_cast<signed char>(current - turn)));
+    unsigned long scoreLeft = static_cast<unsigned long>(left) * 256 / (256 + penalty(time, static_cast<signed char>(current + turn)));
+    bool turnLeft = scoreRight < scoreLeft;
+    if (isLooping(time, current))
+        ++m_loops;
+
+    m_records[m_next] = EscapeRecord{time, current, blocked};
+    m_next = (m_next + 1) & (s_size - 1);
+    if (m_count < s_size)
+        ++m_count;
+    return turnLeft;
+}
+
+/**
+ * @brief Get the loops detected since cleared.
+ * @return unsigned short Loops.
+ */
+unsigned short EscapeMemory::getLoops() const
+{
+    return m_loops;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/**
+ * @file escapememory.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Short-term memory of the escape turns in obstacle avoidance, to stop bouncing between the same walls.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef ESCAPEMEMORY_H
+#define ESCAPEMEMORY_H
+
+/**
+ * @brief Stop in front of an obstacle and the turn taken to escape.
+ */
+struct EscapeRecord
+{
+    unsigned long time;  // Time of the stop (ms)
+    signed char heading; // Heading facing the obstacle (1/256 turn)
+    bool blocked;        // Turned 180 deg, no way out ahead nor to the sides
+};
+
+class EscapeMemory
+{
+private:
+    static constexpr unsigned char s_size{8};     // Records kept, a power of 2
+    static constexpr signed char s_near{32};      // Headings closer than 45 deg are the same
+    static constexpr unsigned char s_loopStops{2}; // Previous stops facing the same heading meaning a loop
+    EscapeRecord m_records[s_size];
+    unsigned char m_next;      // Next record to write
+    unsigned char m_count;     // Records written, up to s_size
+    unsigned short m_decay;    // Time until a record is forgotten (ms)
+    unsigned short m_loops;    // Loops detected since cleared
+
+    static signed char toHeading(float heading);
+    static bool isNear(signed char heading1, signed char heading2);
+    unsigned char weight(const EscapeRecord &record, unsigned long time) const;
+    unsigned short penalty(unsigned long time, signed char target) const;
+    bool isLooping(unsigned long time, signed char heading) const;
+
+public:
+    EscapeMemory(unsigned short decay);
+    ~EscapeMemory();
+    void clear();
+    bool chooseLeft(unsigned long time, float heading, unsigned short right, unsigned short left, bool blocked);
+    unsigned short getLoops() const;
+};
+
+#endif
\ No newline at end of file
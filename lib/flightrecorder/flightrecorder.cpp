@@ -0,0 +1,178 @@
+/**
+ * @file flightrecorder.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Ring buffer of events in a .noinit SRAM section, which survives resets for post-mortem analysis.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "flightrecorder.h"
+
+FlightRecord FlightRecorder::s_records[FlightRecorder::s_size] __attribute__((section(".noinit")));
+unsigned char FlightRecorder::s_next __attribute__((section(".noinit")));
+FlightRecord FlightRecorder::s_states[FlightRecorder::s_stateSize] __attribute__((section(".noinit")));
+unsigned char FlightRecorder::s_stateNext __attribute__((section(".noinit")));
+unsigned short FlightRecorder::s_valid __attribute__((section(".noinit")));
+unsigned char FlightRecorder::s_resetCause __attribute__((section(".noinit")));
+bool FlightRecorder::s_streamHeader{false};
+unsigned char FlightRecorder::s_streamFirst{0};
+unsigned char FlightRecorder::s_streamStateFirst{0};
+unsigned char FlightRecorder::s_streamNext{FlightRecorder::s_stateSize + FlightRecorder::s_size};
+
+/**
+ * @brief Save and clear MCUSR before main(), as .bss is not cleared yet in .init3.
+ * Optiboot 6 or newer clears MCUSR and passes it in r2 instead.
+ */
+void FlightRecorder::captureResetCause()
+{
+    unsigned char cause = MCUSR;
+    if (cause == 0)
+        asm volatile("mov %0, r2" : "=r"(cause));
+    s_resetCause = cause & (_BV(WDRF) | _BV(BORF) | _BV(EXTRF) | _BV(PORF));
+    MCUSR = 0;
+    wdt_disable(); // A watchdog reset keeps the watchdog enabled
+}
+
+/**
+ * @brief Validate the buffer kept from before the reset and record the reset. After a power-on
+ * the SRAM content is random, so the buffer is cleared.
+ */
+void FlightRecorder::begin()
+{
+    if ((s_valid != s_magic) || (s_resetCause & _BV(PORF)) || (s_next >= s_size) || (s_stateNext >= s_stateSize))
+    {
+        memset(s_records, 0, sizeof(s_records));
+        memset(s_states, 0, sizeof(s_states));
+        s_next = 0;
+        s_stateNext = 0;
+        s_valid = s_magic;
+    }
+    log(FlightEvent::RESET, s_resetCause);
+}
+
+/**
+ * @brief Check if a record was never written since the buffer was cleared.
+ * @param record Record.
+ * @return true Empty record.
+ * @return false Written record.
+ */
+bool FlightRecorder::isEmpty(const FlightRecord &record)
+{
+    return (record.time == 0) && (record.event == FlightEvent::RESET) && (record.info == 0);
+}
+
+/**
+ * @brief Record in dump order: the state records, then the MOTORS and SONAR ones, each ring oldest first.
+ * @param index Position in dump order.
+ * @param stateFirst Oldest state record.
+ * @param first Oldest MOTORS or SONAR record.
+ * @return const FlightRecord& Record.
+ */
+const FlightRecord &FlightRecorder::at(unsigned char index, unsigned char stateFirst, unsigned char first)
+{
+    if (index < s_stateSize)
+        return s_states[(stateFirst + index) % s_stateSize];
+    return s_records[(first + index - s_stateSize) % s_size];
+}
+
+/**
+ * @brief Send {"N":140,"R":resetCause,"K":size}.
+ */
+void FlightRecorder::printHeader()
+{
+    Serial.print(F("{\"N\":140,\"R\":"));
+    Serial.print(s_resetCause);
+    Serial.print(F(",\"K\":"));
+    Serial.print(s_stateSize + s_size);
+    Serial.println('}');
+}
+
+/**
+ * @brief Send {"N":141,"T":time,"E":event,"I":info,"A":data1,"B":data2}.
+ * @param record Record.
+ */
+void FlightRecorder::printRecord(const FlightRecord &record)
+{
+    Serial.print(F("{\"N\":141,\"T\":"));
+    Serial.print(record.time);
+    Serial.print(F(",\"E\":"));
+    Serial.print(static_cast<unsigned char>(record.event));
+    Serial.print(F(",\"I\":"));
+    Serial.print(record.info);
+    Serial.print(F(",\"A\":"));
+    Serial.print(record.data1);
+    Serial.print(F(",\"B\":"));
+    Serial.print(record.data2);
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the header and the records through Serial, in dump order. Empty records are skipped.
+ * Blocks until everything is queued, so only for the start, with the motors stopped.
+ */
+void FlightRecorder::dump()
+{
+    printHeader();
+    for (unsigned char i{0}; i < s_stateSize + s_size; ++i)
+    {
+        const FlightRecord &record = at(i, s_stateNext, s_next);
+        if (!isEmpty(record))
+            printRecord(record);
+    }
+}
+
+/**
+ * @brief Start sending the same frames as dump() from stream(), without blocking the caller.
+ */
+void FlightRecorder::requestStream()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        s_streamFirst = (s_next < s_size) ? s_next : 0;
+        s_streamStateFirst = (s_stateNext < s_stateSize) ? s_stateNext : 0;
+    }
+    s_streamHeader = true;
+    s_streamNext = 0;
+}
+
+/**
+ * @brief Send at most one frame of a requested stream, and only if it fits in the Serial transmit
+ * buffer, so the main loop never waits for the 9600 baud link. Call once per loop.
+ */
+void FlightRecorder::stream()
+{
+    if (!s_streamHeader)
+    {
+        while ((s_streamNext < s_stateSize + s_size) && isEmpty(at(s_streamNext, s_streamStateFirst, s_streamFirst)))
+            ++s_streamNext;
+        if (s_streamNext >= s_stateSize + s_size)
+            return;
+    }
+    if (Serial.availableForWrite() < s_lineLength)
+        return;
+    if (s_streamHeader)
+    {
+        printHeader();
+        s_streamHeader = false;
+        return;
+    }
+    FlightRecord record;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        record = at(s_streamNext, s_streamStateFirst, s_streamFirst); // Also written from interrupts
+    }
+    printRecord(record);
+    ++s_streamNext;
+}
+
+/**
+ * @brief Get the reset cause.
+ * @return unsigned char MCUSR flags at start.
+ */
+unsigned char FlightRecorder::getResetCause()
+{
+    return s_resetCause;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+/**
+ * @file flightrecorder.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Ring buffer of events in a .noinit SRAM section, which survives resets for post-mortem analysis.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <Arduino.h>
+#include <util/atomic.h>
+
+/**
+ * @brief Recorded events. The info and data meaning depends on the event. MOTORS and SONAR, frequent,
+ * have their own ring, so they never evict the others.
+ */
+enum class FlightEvent : unsigned char
+{
+    RESET,  // info: reset cause (MCUSR)
+    MODE,   // info: RobotMode
+    STATE,  // info: RobotModeState
+    MOTORS, // data1: left speed, data2: right speed
+    SONAR,  // info: 0 servo sonar, UltrasonicArray sensor + 1, data1: distance (cm), data2: echo duration (us), 0 if timeout
+    BATTERY, // info: BatteryLevel, data1: voltage (mV)
+};
+
+struct FlightRecord
+{
+    unsigned short time; // Core millis(), low 16 bits: real ms only at the default PWM frequency, see Clock
+    FlightEvent event;
+    unsigned char info;
+    short data1;
+    short data2;
+};
+
+class FlightRecorder
+{
+private:
+    static constexpr unsigned char s_size{16};       // Number of MOTORS and SONAR records
+    static constexpr unsigned char s_stateSize{8};   // Number of RESET, MODE, STATE and BATTERY records
+    static constexpr unsigned short s_magic{0xF17F}; // Valid buffer mark, changed with the layout
+    static FlightRecord s_records[s_size];           // In .noinit
+    static unsigned char s_next;                     // Next record to write. In .noinit
+    static FlightRecord s_states[s_stateSize];       // In .noinit
+    static unsigned char s_stateNext;                // Next state record to write. In .noinit
+    static unsigned short s_valid;                   // s_magic if the buffer is valid. In .noinit
+    static unsigned char s_resetCause;               // MCUSR at start. In .noinit
+    static constexpr unsigned char s_lineLength{60}; // Longest frame, CR LF included
+    static bool s_streamHeader;                      // Header frame pending
+    static unsigned char s_streamFirst;              // Oldest record when the stream was requested
+    static unsigned char s_streamStateFirst;         // Oldest state record when the stream was requested
+    static unsigned char s_streamNext;               // Next record to stream in dump order, s_stateSize + s_size if done
+
+    static void captureResetCause() __attribute__((naked, used, section(".init3")));
+    static bool isEmpty(const FlightRecord &record);
+    static const FlightRecord &at(unsigned char index, unsigned char stateFirst, unsigned char first);
+    static void printHeader();
+    static void printRecord(const FlightRecord &record);
+
+public:
+    static void begin();
+    static void dump();
+    static void requestStream();
+    static void stream();
+    static unsigned char getResetCause();
+
+    /**
+     * @brief Record an event. Only a few cycles, also from interrupts.
+     * @param event Event.
+     * @param info Event information.
+     * @param data1 Event data.
+     * @param data2 Event data.
+     */
+    static inline void log(FlightEvent event, unsigned char info, short data1 = 0, short data2 = 0)
+    {
+        bool frequent = (event == FlightEvent::MOTORS) || (event == FlightEvent::SONAR);
+        FlightRecord *records = frequent ? s_records : s_states;
+        unsigned char &next = frequent ? s_next : s_stateNext;
+        unsigned char size = frequent ? s_size : s_stateSize;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            if (next >= size) // Not initialized yet
+                next = 0;
+            FlightRecord &record = records[next];
+            record.time = static_cast<unsigned short>(millis()); // Clock::millis() is not for interrupts
+            record.event = event;
+            record.info = info;
+            record.data1 = data1;
+            record.data2 = data2;
+            if (++next >= size)
+                next = 0;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
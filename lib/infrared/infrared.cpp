@@ -2,19 +2,34 @@
  * @file infrared.cpp
  * @author José Ángel Sánchez (https://github.com/gelanchez)
  * @brief Library for receiving and processing data from the IR sensor.
- * @version 1.2.0
- * @date 2022-04-18
+ * @version 1.3.0
+ * @date 2026-10-19
  * @copyright GPL-3.0
  */
 
-#include <IRremote.hpp>
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "clock.h"
 #include "infrared.h"
 
+unsigned char Infrared::s_pinMask{0};
+volatile bool Infrared::s_enabled{false};
+Infrared::State Infrared::s_state{Infrared::State::IDLE};
+unsigned char Infrared::s_bits{0};
+unsigned long Infrared::s_code{0};
+Key Infrared::s_lastKey{Key::unkwown};
+SpscQueue<IREvent, 8> Infrared::s_events;
+
+ISR(PCINT0_vect) // Also wakes up LowPower::idle()
+{
+    Infrared::edge();
+}
+
 /**
  * @brief Construct a new Infrared::Infrared object.
- * @param IRPin IR receiver pin.
+ * @param IRPin IR receiver pin, in port B (pins 8-13).
  */
-Infrared::Infrared(unsigned char IRPin) : m_IRPin{IRPin}, m_previousKey{0}
+Infrared::Infrared(unsigned char IRPin) : m_IRPin{IRPin}
 {
 }
 
@@ -26,68 +41,222 @@ Infrared::~Infrared()
 }
 
 /**
- * @brief Start the IR receiver.
+ * @brief Start the IR receiver: Timer2 at 64 us ticks, without interrupts, and the pin change interrupt.
  */
 void Infrared::begin()
 {
-    IrReceiver.begin(m_IRPin, DISABLE_LED_FEEDBACK);
+    pinMode(m_IRPin, INPUT);
+    s_pinMask = digitalPinToBitMask(m_IRPin);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TIMSK2 = 0;
+        TCCR2A = 0;                                   // Normal mode
+        TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);   // Prescaler 1024
+        TCNT2 = 0;
+        TIFR2 = _BV(TOV2);
+        s_state = State::IDLE;
+        s_enabled = true;
+        *digitalPinToPCMSK(m_IRPin) |= bit(digitalPinToPCMSKbit(m_IRPin));
+        PCICR |= bit(digitalPinToPCICRbit(m_IRPin));
+    }
+}
+
+/**
+ * @brief Stop the IR receiver. The pin change interrupt is kept for other pins of the port.
+ */
+void Infrared::end()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        s_enabled = false;
+        *digitalPinToPCMSK(m_IRPin) &= ~bit(digitalPinToPCMSKbit(m_IRPin));
+        if (*digitalPinToPCMSK(m_IRPin) == 0)
+            PCICR &= ~bit(digitalPinToPCICRbit(m_IRPin));
+        TCCR2B = 0;
+    }
+}
+
+/**
+ * @brief Take the oldest key received.
+ * @param event Key event, its time in Clock::millis().
+ * @return true Key read.
+ * @return false No keys.
+ */
+bool Infrared::read(IREvent &event)
+{
+    if (!s_events.pop(event))
+        return false;
+    event.time = Clock::millis() - Clock::toReal(::millis() - event.time);
+    return true;
+}
+
+/**
+ * @brief Discard the keys received.
+ */
+void Infrared::clear()
+{
+    IREvent event;
+    while (s_events.pop(event))
+        ;
+}
+
+/**
+ * @brief Whether a time measured in Timer2 ticks is in a range.
+ * @param ticks Timer2 ticks of 64 us, 255 after an overflow.
+ * @param minimum Minimum time (us).
+ * @param maximum Maximum time (us).
+ * @return true In range.
+ * @return false Out of range.
+ */
+bool Infrared::inRange(unsigned char ticks, unsigned short minimum, unsigned short maximum)
+{
+    unsigned short time = static_cast<unsigned short>(ticks) << 6;
+    return (time >= minimum) && (time <= maximum);
 }
 
 /**
- * @brief Decode pressed key.
+ * @brief Drop a malformed frame. The last key is not repeated any more, the repeats could belong
+ * to a missed frame.
+ * @param mark A mark started, which could be the leading one of a new frame.
+ */
+void Infrared::fail(bool mark)
+{
+    s_state = mark ? State::LEADMARK : State::IDLE;
+    s_lastKey = Key::unkwown;
+}
+
+/**
+ * @brief Decode the pressed key.
+ * @param code NEC frame, LSB first.
  * @return Key.
  */
-Key Infrared::decodeIR()
+Key Infrared::mapKey(unsigned long code)
 {
-    if (IrReceiver.decode())
+    switch (code)
     {
-        unsigned long pressedKey = IrReceiver.decodedIRData.decodedRawData;
-        IrReceiver.resume();
+    case 3208707840:
+        return Key::keyOk;
+    case 3108437760:
+        return Key::keyUp;
+    case 3927310080:
+        return Key::keyDown;
+    case 3141861120:
+        return Key::keyLeft;
+    case 3158572800:
+        return Key::keyRight;
+    case 2907897600:
+        return Key::key0;
+    case 3910598400:
+        return Key::key1;
+    case 3860463360:
+        return Key::key2;
+    case 4061003520:
+        return Key::key3;
+    case 4077715200:
+        return Key::key4;
+    case 3877175040:
+        return Key::key5;
+    case 2707357440:
+        return Key::key6;
+    case 4144561920:
+        return Key::key7;
+    case 3810328320:
+        return Key::key8;
+    case 2774204160:
+        return Key::key9;
+    case 3175284480:
+        return Key::keyAsterisk;
+    case 3041591040:
+        return Key::keySharp;
+    default:
+        return Key::unkwown;
+    }
+}
 
-        if (pressedKey == 0) // Repeat previous key
-            pressedKey = m_previousKey;
-        else
-            m_previousKey = pressedKey; // Update previous key to current key
+/**
+ * @brief Decode the NEC frame with the time since the previous edge. Called from the pin change interrupt.
+ */
+void Infrared::edge()
+{
+    unsigned char ticks = TCNT2;
+    TCNT2 = 0;
+    if (TIFR2 & _BV(TOV2)) // Longer than 16 ms
+    {
+        TIFR2 = _BV(TOV2);
+        ticks = 255;
+    }
+    if (!s_enabled)
+        return;
+    bool mark = !(PINB & s_pinMask); // Receiver low with carrier: a mark starts, the time was a space
 
-        switch (pressedKey)
+    switch (s_state)
+    {
+    case State::IDLE:
+        if (mark)
+            s_state = State::LEADMARK;
+        break;
+    case State::LEADMARK:
+        if (!mark && inRange(ticks, 7000, 11000))
+            s_state = State::LEADSPACE;
+        else
+            fail(mark);
+        break;
+    case State::LEADSPACE:
+        if (mark && inRange(ticks, 3500, 5500))
+        {
+            s_bits = 0;
+            s_code = 0;
+            s_state = State::BITMARK;
+        }
+        else if (mark && inRange(ticks, 1700, 2800))
+            s_state = State::REPEATMARK;
+        else
+            fail(mark);
+        break;
+    case State::BITMARK:
+        if (mark || !inRange(ticks, 300, 900))
         {
-        case 3208707840:
-            return Key::keyOk;
-        case 3108437760:
-            return Key::keyUp;
-        case 3927310080:
-            return Key::keyDown;
-        case 3141861120:
-            return Key::keyLeft;
-        case 3158572800:
-            return Key::keyRight;
-        case 2907897600:
-            return Key::key0;
-        case 3910598400:
-            return Key::key1;
-        case 3860463360:
-            return Key::key2;
-        case 4061003520:
-            return Key::key3;
-        case 4077715200:
-            return Key::key4;
-        case 3877175040:
-            return Key::key5;
-        case 2707357440:
-            return Key::key6;
-        case 4144561920:
-            return Key::key7;
-        case 3810328320:
-            return Key::key8;
-        case 2774204160:
-            return Key::key9;
-        case 3175284480:
-            return Key::keyAsterisk;
-        case 3041591040:
-            return Key::keySharp;
-        default:
-            return Key::unkwown;
+            fail(mark);
+            break;
         }
+        if (s_bits < 32)
+        {
+            s_state = State::BITSPACE;
+            break;
+        }
+        s_state = State::IDLE; // Stop bit
+        s_lastKey = Key::unkwown;
+        if ((((s_code >> 16) ^ (s_code >> 24)) & 0xFF) == 0xFF) // Command and its inverse
+            s_lastKey = mapKey(s_code);
+        if (s_lastKey != Key::unkwown)
+            s_events.push(IREvent{s_lastKey, false, ::millis()}); // Dropped if full
+        break;
+    case State::BITSPACE:
+        if (!mark)
+        {
+            fail(mark);
+            break;
+        }
+        s_code >>= 1; // LSB first
+        if (inRange(ticks, 1125, 2300)) // Split halfway between 562 us and 1687 us
+            s_code |= 0x80000000UL;
+        else if (!inRange(ticks, 300, 1124))
+        {
+            fail(mark);
+            break;
+        }
+        ++s_bits;
+        s_state = State::BITMARK;
+        break;
+    case State::REPEATMARK:
+        if (!mark && inRange(ticks, 300, 900))
+        {
+            if (s_lastKey != Key::unkwown)
+                s_events.push(IREvent{s_lastKey, true, ::millis()});
+            s_state = State::IDLE;
+        }
+        else
+            fail(mark);
+        break;
     }
-    return Key::unkwown;
 }
\ No newline at end of file
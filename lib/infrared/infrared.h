@@ -2,19 +2,16 @@
  * @file infrared.h
  * @author José Ángel Sánchez (https://github.com/gelanchez)
  * @brief Library for receiving and processing data from the IR sensor.
- * @version 1.2.0
- * @date 2022-04-18
+ * @version 1.3.0
+ * @date 2026-10-19
  * @copyright GPL-3.0
  */
 
 #ifndef INFRARED_H
 #define INFRARED_H
 
-// To avoid using old versions of Arduino IDE, which used WPProgram.h instead or Arduino.h
-// Also possible #define IRPRONTO
-#ifndef ARDUINO
-#define ARDUINO 108012 // Arduino IDE version used when writing the program
-#endif
+#include <Arduino.h>
+#include "spscqueue.h"
 
 /**
  * @brief Keys.
@@ -41,17 +38,57 @@ enum class Key
     unkwown
 };
 
+/**
+ * @brief Key press or repeat received.
+ */
+struct IREvent
+{
+    Key key;
+    bool repeat;       // Repeat frame of a held key
+    unsigned long time; // Time received, core millis() until read, then Clock::millis()
+};
+
+/**
+ * @brief NEC frames decoder on the receiver pin change interrupt, timed with Timer2 (64 us ticks).
+ * Timer2 is reset at every edge, an overflow means a gap longer than a frame element.
+ */
 class Infrared
 {
 private:
-    unsigned char m_IRPin;       // IR receiver pin
-    unsigned long m_previousKey; // Store previous order for repeating key
+    /**
+     * @brief Decoder states, named after the element being received.
+     */
+    enum class State : unsigned char
+    {
+        IDLE,
+        LEADMARK,   // 9 ms
+        LEADSPACE,  // 4.5 ms, 2.25 ms for a repeat
+        BITMARK,    // 562 us, also the stop bit
+        BITSPACE,   // 562 us zero, 1687 us one
+        REPEATMARK, // Repeat stop bit
+    };
+
+    unsigned char m_IRPin;                  // IR receiver pin, in port B (pins 8-13)
+    static unsigned char s_pinMask;         // Receiver bit in PINB
+    static volatile bool s_enabled;
+    static State s_state;
+    static unsigned char s_bits;            // Bits received of the frame
+    static unsigned long s_code;            // Frame, LSB first: address, ~address, command, ~command
+    static Key s_lastKey;                   // Key repeated by the repeat frames
+    static SpscQueue<IREvent, 8> s_events;  // Interrupt to main program
+
+    static bool inRange(unsigned char ticks, unsigned short minimum, unsigned short maximum);
+    static Key mapKey(unsigned long code);
+    static void fail(bool mark);
 
 public:
     Infrared(unsigned char IRPin);
     ~Infrared();
     void begin();
-    Key decodeIR();
+    void end();
+    bool read(IREvent &event);
+    void clear();
+    static void edge();
 };
 
 #endif
\ No newline at end of file
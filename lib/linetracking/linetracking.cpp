@@ -84,6 +84,22 @@ void LineTracking::printLines() const
     Serial.println();
 }
 
+/**
+ * @brief Read the three sensors at once.
+ * @return unsigned char Detected lines, s_left | s_mid | s_right.
+ */
+unsigned char LineTracking::read() const
+{
+    unsigned char lines{0};
+    if (leftLine())
+        lines |= s_left;
+    if (midLine())
+        lines |= s_mid;
+    if (rightLine())
+        lines |= s_right;
+    return lines;
+}
+
 /**
  * @brief Check right sensor.
  * @return true Line detected.
@@ -17,6 +17,10 @@ private:
     unsigned char m_midPin; // Mid sensor pin
     unsigned char m_rightPin; // Right sensor pin
 public:
+    static constexpr unsigned char s_left{1}; // Bits of read()
+    static constexpr unsigned char s_mid{2};
+    static constexpr unsigned char s_right{4};
+    static constexpr unsigned char s_all{s_left | s_mid | s_right};
     LineTracking(unsigned char leftPin, unsigned char midPin, unsigned char rightPin);
     ~LineTracking();
     bool allLines() const;
@@ -24,6 +28,7 @@ public:
     bool leftLine() const;
     bool midLine() const;
     void printLines() const;
+    unsigned char read() const;
     bool rightLine() const;
 };
 
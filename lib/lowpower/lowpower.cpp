@@ -0,0 +1,56 @@
+/**
+ * @file lowpower.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Library to put the MCU to sleep until a serial byte is received or a pin changes.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include "lowpower.h"
+
+/**
+ * @brief Sleep in idle mode until a byte is received by the UART or the wake pin changes.
+ * The UART keeps its clock in idle mode, so the byte which wakes the MCU is not lost.
+ * The Timer0 tick is stopped while sleeping, millis() does not advance. Timer1 (servo)
+ * interrupts are also masked, detach the servo before. Timer2 interrupts must be stopped by the caller.
+ * @param wakePin Pin change wake-up, it must be in port B (pins 8-13), whose interrupt is handled by Infrared.
+ */
+void LowPower::idle(unsigned char wakePin)
+{
+    unsigned char timerMask0 = TIMSK0;
+    unsigned char timerMask1 = TIMSK1;
+    TIMSK0 = 0; // millis() tick would wake up every 1 ms
+    TIMSK1 = 0;
+    power_adc_disable();
+    power_spi_disable();
+    power_twi_disable();
+
+    *digitalPinToPCMSK(wakePin) |= bit(digitalPinToPCMSKbit(wakePin));
+    PCIFR = bit(digitalPinToPCICRbit(wakePin)); // Clear old changes
+    PCICR |= bit(digitalPinToPCICRbit(wakePin));
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    if (Serial.available() == 0) // Nothing received since the last drain
+    {
+        sleep_enable();
+        sei(); // The instruction after sei() is executed before any interrupt, no wake-up is missed
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+
+    *digitalPinToPCMSK(wakePin) &= ~bit(digitalPinToPCMSKbit(wakePin));
+    if (*digitalPinToPCMSK(wakePin) == 0) // Other pins of the port still watched
+        PCICR &= ~bit(digitalPinToPCICRbit(wakePin));
+    power_twi_enable();
+    power_spi_enable();
+    power_adc_enable();
+    TIMSK1 = timerMask1;
+    TIMSK0 = timerMask0;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+/**
+ * @file lowpower.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Library to put the MCU to sleep until a serial byte is received or a pin changes.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef LOWPOWER_H
+#define LOWPOWER_H
+
+#include <Arduino.h>
+
+class LowPower
+{
+public:
+    static void idle(unsigned char wakePin);
+};
+
+#endif
\ No newline at end of file
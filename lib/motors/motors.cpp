@@ -7,6 +7,9 @@
  * @copyright GPL-3.0
  */
 
+#include <util/atomic.h>
+#include "clock.h"
+#include "flightrecorder.h"
 #include "motors.h"
 
 /**
@@ -21,7 +24,7 @@
  * @param idleSpeed Minimum idle speed.
  */
 Motors::Motors(unsigned char enableA, unsigned char input1, unsigned char input2, unsigned char enableB, unsigned char input3, unsigned char input4, unsigned char crankSpeed, unsigned char idleSpeed)
-    : m_enableA{enableA}, m_input1{input1}, m_input2{input2}, m_enableB{enableB}, m_input3{input3}, m_input4{input4}, m_crankSpeed{crankSpeed}, m_idleSpeed{idleSpeed}, m_leftSpeed{0}, m_rightSpeed{0}
+    : m_enableA{enableA}, m_input1{input1}, m_input2{input2}, m_enableB{enableB}, m_input3{input3}, m_input4{input4}, m_crankSpeed{crankSpeed}, m_idleSpeed{idleSpeed}, m_leftSpeed{0}, m_rightSpeed{0}, m_pwmFrequency{PwmFrequency::HZ976}, m_voltageScale{256}, m_rescale{false}
 {
     pinMode(enableA, OUTPUT);
     pinMode(input1, OUTPUT);
@@ -47,7 +50,12 @@ Motors::~Motors()
  */
 short Motors::getLeftSpeed() const
 {
-    return m_leftSpeed;
+    short speed;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        speed = m_leftSpeed;
+    }
+    return speed;
 }
 
 /**
@@ -56,7 +64,26 @@ short Motors::getLeftSpeed() const
  */
 short Motors::getRightSpeed() const
 {
-    return m_rightSpeed;
+    short speed;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        speed = m_rightSpeed;
+    }
+    return speed;
+}
+
+/**
+ * @brief Get both sides speeds at once, consistent when the control tick drives the motors.
+ * @param leftSpeed Left motors speed.
+ * @param rightSpeed Right motors speed.
+ */
+void Motors::getSpeeds(short &leftSpeed, short &rightSpeed) const
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        leftSpeed = m_leftSpeed;
+        rightSpeed = m_rightSpeed;
+    }
 }
 
 /**
@@ -66,7 +93,9 @@ short Motors::getRightSpeed() const
  */
 bool Motors::isStopped() const
 {
-    if ((m_leftSpeed == 0) && (m_rightSpeed == 0))
+    short leftSpeed, rightSpeed;
+    getSpeeds(leftSpeed, rightSpeed);
+    if ((leftSpeed == 0) && (rightSpeed == 0))
         return true;
     return false;
 }
@@ -78,7 +107,9 @@ bool Motors::isStopped() const
  */
 bool Motors::isRotatingLeft() const
 {
-    if ((m_leftSpeed < 0) && (m_rightSpeed > 0))
+    short leftSpeed, rightSpeed;
+    getSpeeds(leftSpeed, rightSpeed);
+    if ((leftSpeed < 0) && (rightSpeed > 0))
         return true;
     return false;
 }
@@ -90,11 +121,117 @@ bool Motors::isRotatingLeft() const
  */
 bool Motors::isRotatingRight() const
 {
-    if ((m_leftSpeed > 0) && (m_rightSpeed < 0))
+    short leftSpeed, rightSpeed;
+    getSpeeds(leftSpeed, rightSpeed);
+    if ((leftSpeed > 0) && (rightSpeed < 0))
         return true;
     return false;
 }
 
+/**
+ * @brief Get the motors PWM frequency.
+ * @return PwmFrequency PWM frequency.
+ */
+PwmFrequency Motors::getPwmFrequency() const
+{
+    return m_pwmFrequency;
+}
+
+/**
+ * @brief Get the battery voltage compensation.
+ * @return unsigned short Nominal / battery voltage, 256 = 1.
+ */
+unsigned short Motors::getVoltageScale() const
+{
+    return m_voltageScale;
+}
+
+/**
+ * @brief Compensate the battery voltage, so that the speeds, the minimum speeds and the times to
+ * rotate measured at the nominal voltage stay valid. The current speeds are written again by the
+ * next move(), from whoever drives the motors: the control tick may own them, and writing the
+ * H-bridge from here could interleave with its own writes.
+ * @param scale Nominal / battery voltage, 256 = 1.
+ */
+void Motors::setVoltageScale(unsigned short scale)
+{
+    if (scale == m_voltageScale)
+        return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        m_voltageScale = scale; // Read by dutyCycle() in the control tick
+        m_rescale = true;
+    }
+}
+
+/**
+ * @brief Set the minimum speeds to prevent buzzing.
+ * @param crankSpeed Minimun crank speed.
+ * @param idleSpeed Minimum idle speed.
+ */
+void Motors::setMinSpeeds(unsigned char crankSpeed, unsigned char idleSpeed)
+{
+    m_crankSpeed = crankSpeed;
+    m_idleSpeed = idleSpeed;
+}
+
+/**
+ * @brief Set the PWM frequency of the enable pins, which must be the Timer0 outputs (pins 5 and 6).
+ * Timer0 also runs millis(), micros() and delay(): use Clock instead, which is rescaled here.
+ * Timer0 overflow interrupts are frequent at 31372 Hz (~10% of the CPU).
+ * @param frequency PWM frequency.
+ */
+void Motors::setPwmFrequency(PwmFrequency frequency)
+{
+    if (frequency == m_pwmFrequency)
+        return;
+
+    unsigned char mode{_BV(WGM01) | _BV(WGM00)}; // Fast PWM
+    unsigned char prescaler{_BV(CS01) | _BV(CS00)};
+    unsigned int numerator{1}, denominator{1}; // Core time (1024 us per overflow) per real time
+    switch (frequency)
+    {
+    case PwmFrequency::HZ61:
+        prescaler = _BV(CS02) | _BV(CS00);
+        denominator = 16;
+        break;
+    case PwmFrequency::HZ244:
+        prescaler = _BV(CS02);
+        denominator = 4;
+        break;
+    case PwmFrequency::HZ3922:
+        mode = _BV(WGM00); // Phase correct PWM: 510 ticks per overflow
+        prescaler = _BV(CS01);
+        numerator = 1024;
+        denominator = 255;
+        break;
+    case PwmFrequency::HZ7812:
+        prescaler = _BV(CS01);
+        numerator = 8;
+        break;
+    case PwmFrequency::HZ31372:
+        mode = _BV(WGM00);
+        prescaler = _BV(CS00);
+        numerator = 8192;
+        denominator = 255;
+        break;
+    case PwmFrequency::HZ976:
+        break;
+    default:
+        return;
+    }
+
+    Clock::millis(); // Time until now at the previous scale
+    Clock::micros();
+    uint8_t oldSREG = SREG;
+    cli();
+    TCCR0A = (TCCR0A & ~(_BV(WGM01) | _BV(WGM00))) | mode; // Keep the output compare modes
+    TCCR0B = (TCCR0B & ~(_BV(CS02) | _BV(CS01) | _BV(CS00))) | prescaler;
+    SREG = oldSREG;
+    Clock::setScale(numerator, denominator);
+    m_pwmFrequency = frequency;
+}
+
 /**
  * @brief Drive the motors with a PWM signal.
  * @param leftSpeed PWM value: -255..255.
@@ -102,9 +239,10 @@ bool Motors::isRotatingRight() const
  */
 void Motors::move(short leftSpeed, short rightSpeed)
 {
-    // Return if no speed change
-    if ((m_leftSpeed == leftSpeed) && (m_rightSpeed == rightSpeed))
+    // Return if no speed or voltage scale change
+    if ((m_leftSpeed == leftSpeed) && (m_rightSpeed == rightSpeed) && !m_rescale)
         return;
+    m_rescale = false;
 
     // Limit values
     leftSpeed = constrain(leftSpeed, -255, 255);
@@ -117,12 +255,83 @@ void Motors::move(short leftSpeed, short rightSpeed)
     // Member variables update first
     m_leftSpeed = (abs(leftSpeed) < minLeftSpeed) ? 0 : leftSpeed;
     m_rightSpeed = (abs(rightSpeed) < minRightSpeed) ? 0 : rightSpeed;
+    FlightRecorder::log(FlightEvent::MOTORS, 0, m_leftSpeed, m_rightSpeed);
+    write();
+}
 
+/**
+ * @brief Differential-drive mixing of both sides speeds. When a side saturates both are scaled
+ * down, and when a side is below its minimum speed both are scaled up, keeping the curvature.
+ * If the outer side saturates first, the inner one stops or moves at its minimum, the closer.
+ * Integer only: also called from the control tick.
+ * @param leftSpeed Left side speed: positive forward.
+ * @param rightSpeed Right side speed: positive forward.
+ */
+void Motors::mix(short leftSpeed, short rightSpeed)
+{
+    // Saturation
+    short outer = max(abs(leftSpeed), abs(rightSpeed));
+    if (outer > 255)
+    {
+        leftSpeed = static_cast<long>(leftSpeed) * 255 / outer;
+        rightSpeed = static_cast<long>(rightSpeed) * 255 / outer;
+        outer = 255;
+    }
+
+    // Dead band, minimum speeds as in move()
+    unsigned char minLeftSpeed = (m_leftSpeed == 0) ? m_crankSpeed : m_idleSpeed;
+    unsigned char minRightSpeed = (m_rightSpeed == 0) ? m_crankSpeed : m_idleSpeed;
+    long target{outer}; // Outer speed lifting both sides over their minimum
+    if ((leftSpeed != 0) && (abs(leftSpeed) < minLeftSpeed))
+        target = max(target, static_cast<long>(outer) * minLeftSpeed / abs(leftSpeed));
+    if ((rightSpeed != 0) && (abs(rightSpeed) < minRightSpeed))
+        target = max(target, static_cast<long>(outer) * minRightSpeed / abs(rightSpeed));
+    if (target > outer)
+    {
+        target = min(target, 255L);
+        leftSpeed = static_cast<long>(leftSpeed) * target / outer;
+        rightSpeed = static_cast<long>(rightSpeed) * target / outer;
+    }
+    move(deadBand(leftSpeed, minLeftSpeed), deadBand(rightSpeed, minRightSpeed));
+}
+
+/**
+ * @brief Round a side speed below its minimum to 0 or to the minimum, the closer.
+ * @param speed Side speed.
+ * @param minSpeed Minimum speed of the side.
+ * @return short Speed out of the dead band.
+ */
+short Motors::deadBand(short speed, unsigned char minSpeed)
+{
+    if (abs(speed) >= minSpeed)
+        return speed;
+    if (abs(speed) < (minSpeed + 1) / 2)
+        return 0;
+    return (speed > 0) ? minSpeed : -minSpeed;
+}
+
+/**
+ * @brief PWM duty cycle giving a speed at the current battery voltage. The speeds and the minimum
+ * speeds are measured at the nominal voltage, so the dead band moves with the duty cycle.
+ * @param speed Speed, -255..255 at the nominal voltage.
+ * @return unsigned char Duty cycle, saturated at 255.
+ */
+unsigned char Motors::dutyCycle(short speed) const
+{
+    unsigned long duty = (static_cast<unsigned long>(abs(speed)) * m_voltageScale) >> 8;
+    return (duty > 255) ? 255 : duty;
+}
+
+/**
+ * @brief Write the current speeds to the H-bridge.
+ */
+void Motors::write()
+{
     if (m_leftSpeed < 0)
     {
         digitalWrite(m_input3, HIGH);
         digitalWrite(m_input4, LOW);
-        analogWrite(m_enableB, abs(m_leftSpeed));
+        analogWrite(m_enableB, dutyCycle(m_leftSpeed));
     }
     else if (m_leftSpeed == 0)
         analogWrite(m_enableB, 0);
@@ -130,14 +339,14 @@ void Motors::move(short leftSpeed, short rightSpeed)
     {
         digitalWrite(m_input3, LOW);
         digitalWrite(m_input4, HIGH);
-        analogWrite(m_enableB, m_leftSpeed);
+        analogWrite(m_enableB, dutyCycle(m_leftSpeed));
     }
 
     if (m_rightSpeed < 0)
     {
         digitalWrite(m_input1, LOW);
         digitalWrite(m_input2, HIGH);
-        analogWrite(m_enableA, abs(m_rightSpeed));
+        analogWrite(m_enableA, dutyCycle(m_rightSpeed));
     }
     else if (m_rightSpeed == 0)
         analogWrite(m_enableA, 0);
@@ -145,17 +354,39 @@ void Motors::move(short leftSpeed, short rightSpeed)
     {
         digitalWrite(m_input1, HIGH);
         digitalWrite(m_input2, LOW);
-        analogWrite(m_enableA, m_rightSpeed);
+        analogWrite(m_enableA, dutyCycle(m_rightSpeed));
     }
 }
 
+/**
+ * @brief Move with a linear speed and a turn rate. See mix() for the saturation and the dead band.
+ * @param linear Linear speed: -255..255, positive forward.
+ * @param angular Turn rate as PWM difference from the linear speed on each side: -255..255, positive left.
+ */
+void Motors::moveVector(short linear, short angular)
+{
+    mix(linear - angular, linear + angular);
+}
+
+/**
+ * @brief Move with a linear speed along an arc. See mix() for the saturation and the dead band.
+ * @param linear Linear speed: -255..255, positive forward.
+ * @param curvature Half the track over the turn radius, positive left: 0 straight, 1 pivoting on
+ * the inner side, larger counter-rotating it.
+ */
+void Motors::drive(short linear, float curvature)
+{
+    curvature = constrain(curvature, -s_maxCurvature, s_maxCurvature);
+    mix(linear * (1 - curvature), linear * (1 + curvature));
+}
+
 /**
  * @brief Move robot forward.
  * @param speed Robot speed (0..255).
  */
 void Motors::forward(unsigned char speed)
 {
-    move(speed, speed);
+    mix(speed, speed);
 }
 
 /**
@@ -164,7 +395,7 @@ void Motors::forward(unsigned char speed)
  */
 void Motors::backward(unsigned char speed)
 {
-    move(-speed, -speed);
+    mix(-speed, -speed);
 }
 
 /**
@@ -173,7 +404,7 @@ void Motors::backward(unsigned char speed)
  */
 void Motors::left(unsigned char speed)
 {
-    move(-speed, speed);
+    mix(-speed, speed);
 }
 
 /**
@@ -182,7 +413,7 @@ void Motors::left(unsigned char speed)
  */
 void Motors::right(unsigned char speed)
 {
-    move(speed, -speed);
+    mix(speed, -speed);
 }
 
 /**
@@ -191,7 +422,7 @@ void Motors::right(unsigned char speed)
  */
 void Motors::forwardLeft(unsigned char speed)
 {
-    move(speed/2, speed);
+    mix(speed / 2, speed);
 }
 
 /**
@@ -200,7 +431,7 @@ void Motors::forwardLeft(unsigned char speed)
  */
 void Motors::forwardRight(unsigned char speed)
 {
-    move(speed, speed/2);
+    mix(speed, speed / 2);
 }
 
 /**
@@ -209,7 +440,7 @@ void Motors::forwardRight(unsigned char speed)
  */
 void Motors::backwardLeft(unsigned char speed)
 {
-    move(-speed/2, -speed);
+    mix(-speed / 2, -speed);
 }
 
 /**
@@ -218,7 +449,7 @@ void Motors::backwardLeft(unsigned char speed)
  */
 void Motors::backwardRight(unsigned char speed)
 {
-    move(-speed, -speed/2);
+    mix(-speed, -speed / 2);
 }
 
 /**
@@ -242,4 +473,5 @@ void Motors::stop()
     digitalWrite(m_enableB, LOW);
     m_leftSpeed = 0;
     m_rightSpeed = 0;
+    FlightRecorder::log(FlightEvent::MOTORS, 0);
 }
\ No newline at end of file
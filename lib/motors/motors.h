@@ -12,23 +12,55 @@
 
 #include <Arduino.h>
 
+/**
+ * @brief Motors PWM frequencies available on Timer0 (pins 5 and 6).
+ */
+enum class PwmFrequency : unsigned char
+{
+    HZ61,    // Fast PWM, prescaler 1024
+    HZ244,   // Fast PWM, prescaler 256
+    HZ976,   // Fast PWM, prescaler 64 (Arduino default)
+    HZ3922,  // Phase correct PWM, prescaler 8
+    HZ7812,  // Fast PWM, prescaler 8
+    HZ31372, // Phase correct PWM, prescaler 1
+    COUNT,   // Number of frequencies
+};
+
 class Motors
 {
 private:
     unsigned char m_enableA, m_input1, m_input2; // Right motors pins
     unsigned char m_enableB, m_input3, m_input4; // Left motors pins
     unsigned char m_crankSpeed, m_idleSpeed;     // Minimum speeds
-    short m_leftSpeed, m_rightSpeed;
+    volatile short m_leftSpeed, m_rightSpeed;   // Written by the control tick in line tracking
+    PwmFrequency m_pwmFrequency;
+    unsigned short m_voltageScale;               // Nominal / battery voltage, 256 = 1
+    volatile bool m_rescale;                     // Voltage scale changed, written by the next move()
+
+    static constexpr float s_maxCurvature{100}; // Rotating in place beyond, see moveVector()
+
+    unsigned char dutyCycle(short speed) const;
+    static short deadBand(short speed, unsigned char minSpeed);
+    void mix(short leftSpeed, short rightSpeed);
+    void write();
 
 public:
     Motors(unsigned char enableA, unsigned char input1, unsigned char input2, unsigned char enableB, unsigned char input3, unsigned char input4, unsigned char crankSpeed, unsigned char idleSpeed);
     ~Motors();
     short getLeftSpeed() const;
     short getRightSpeed() const;
+    void getSpeeds(short &leftSpeed, short &rightSpeed) const;
     bool isStopped() const;
     bool isRotatingLeft() const;
     bool isRotatingRight() const;
+    PwmFrequency getPwmFrequency() const;
+    void setMinSpeeds(unsigned char crankSpeed, unsigned char idleSpeed);
+    void setPwmFrequency(PwmFrequency frequency);
+    unsigned short getVoltageScale() const;
+    void setVoltageScale(unsigned short scale);
     void move(short leftSpeed, short rightSpeed);
+    void moveVector(short linear, short angular);
+    void drive(short linear, float curvature);
     void forward(unsigned char speed);
     void backward(unsigned char speed);
     void left(unsigned char speed);
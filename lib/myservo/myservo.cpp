@@ -39,4 +39,23 @@ void MyServo::begin()
 {
     Servo::attach(m_servoPin, m_servo0, m_servo180);
     Servo::write(90);
+}
+
+/**
+ * @brief Set the 0 deg and 180 deg PWM positions, attaching again the servo if already attached.
+ * @param servo0 0 deg PWM position.
+ * @param servo180 180 deg PWM position.
+ */
+void MyServo::setEndpoints(unsigned int servo0, unsigned int servo180)
+{
+    if ((servo0 == m_servo0) && (servo180 == m_servo180))
+        return;
+    m_servo0 = servo0;
+    m_servo180 = servo180;
+    if (Servo::attached())
+    {
+        int angle = Servo::read(); // Keep the angle with the new endpoints
+        Servo::attach(m_servoPin, m_servo0, m_servo180);
+        Servo::write(angle);
+    }
 }
\ No newline at end of file
@@ -22,6 +22,7 @@ public:
     MyServo(unsigned char servoPin, unsigned int servo0, unsigned int servo180);
     ~MyServo();
     void begin();
+    void setEndpoints(unsigned int servo0, unsigned int servo180);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+/**
+ * @file obstaclegrid.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Fixed-size occupancy grid of 1 bit per cell, remembering the obstacles found by the sonar.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "obstaclegrid.h"
+
+/**
+ * @brief Construct a new ObstacleGrid::ObstacleGrid object.
+ */
+ObstacleGrid::ObstacleGrid()
+{
+    clear();
+}
+
+/**
+ * @brief Destroy the ObstacleGrid::ObstacleGrid object.
+ */
+ObstacleGrid::~ObstacleGrid()
+{
+}
+
+/**
+ * @brief Get the cell of a position.
+ * @param x Position along the initial heading (cm).
+ * @param y Position to the left of the initial heading (cm).
+ * @param cell Cell index.
+ * @return true Position inside the grid.
+ * @return false Position outside the grid.
+ */
+bool ObstacleGrid::toCell(float x, float y, unsigned short &cell) const
+{
+    float column = x / s_cell + s_size / 2;
+    float row = y / s_cell + s_size / 2;
+    if ((column < 0) || (column >= s_size) || (row < 0) || (row >= s_size))
+        return false;
+    cell = static_cast<unsigned short>(row) * s_size + static_cast<unsigned char>(column);
+    return true;
+}
+
+/**
+ * @brief Return if a cell holds an obstacle.
+ * @param cell Cell index.
+ * @return true Obstacle.
+ * @return false Free or unknown.
+ */
+bool ObstacleGrid::isOccupied(unsigned short cell) const
+{
+    return m_cells[cell / 8] & (1 << (cell % 8));
+}
+
+/**
+ * @brief Mark or clear a cell.
+ * @param cell Cell index.
+ * @param occupied Obstacle.
+ */
+void ObstacleGrid::set(unsigned short cell, bool occupied)
+{
+    if (occupied)
+        m_cells[cell / 8] |= (1 << (cell % 8));
+    else
+        m_cells[cell / 8] &= ~(1 << (cell % 8));
+}
+
+/**
+ * @brief Forget all the obstacles.
+ */
+void ObstacleGrid::clear()
+{
+    memset(m_cells, 0, sizeof(m_cells));
+}
+
+/**
+ * @brief Count the cells with obstacles.
+ * @return unsigned short Occupied cells.
+ */
+unsigned short ObstacleGrid::count() const
+{
+    unsigned short occupied{0};
+    for (unsigned short i{0}; i < sizeof(m_cells); ++i)
+    {
+        for (unsigned char bits = m_cells[i]; bits; bits &= bits - 1)
+            ++occupied;
+    }
+    return occupied;
+}
+
+/**
+ * @brief Return if a position holds an obstacle.
+ * @param x Position along the initial heading (cm).
+ * @param y Position to the left of the initial heading (cm).
+ * @return true Obstacle.
+ * @return false Free, unknown or outside the grid.
+ */
+bool ObstacleGrid::isOccupied(float x, float y) const
+{
+    unsigned short cell;
+    return toCell(x, y, cell) && isOccupied(cell);
+}
+
+/**
+ * @brief Distance to the first known obstacle in a direction, in steps of half a cell.
+ * @param x Start position along the initial heading (cm).
+ * @param y Start position to the left of the initial heading (cm).
+ * @param heading Direction, positive left of the initial heading (rad).
+ * @param maxDistance Maximum distance (cm).
+ * @return unsigned short Distance (cm), maxDistance if no obstacle.
+ */
+unsigned short ObstacleGrid::raycast(float x, float y, float heading, unsigned short maxDistance) const
+{
+    constexpr unsigned char step{s_cell / 2};
+    float dx = cos(heading) * step;
+    float dy = sin(heading) * step;
+    unsigned short cell;
+    for (unsigned short distance{step}; distance < maxDistance; distance += step)
+    {
+        x += dx;
+        y += dy;
+        if (!toCell(x, y, cell))
+            break;
+        if (isOccupied(cell))
+            return distance;
+    }
+    return maxDistance;
+}
+
+/**
+ * @brief Add a sonar reading: the cells crossed by the beam are cleared and the one at the
+ * measured distance is marked.
+ * @param x Sonar position along the initial heading (cm).
+ * @param y Sonar position to the left of the initial heading (cm).
+ * @param heading Beam direction, positive left of the initial heading (rad).
+ * @param distance Measured distance (cm).
+ * @param maxDistance Maximum distance, no obstacle found (cm).
+ */
+void ObstacleGrid::addReading(float x, float y, float heading, unsigned short distance, unsigned short maxDistance)
+{
+    float cosine = cos(heading);
+    float sine = sin(heading);
+    unsigned short cell;
+    unsigned short freeDistance = (distance > s_cell) ? distance - s_cell : 0;
+    for (unsigned short d{s_cell / 2}; d < freeDistance; d += s_cell / 2)
+    {
+        if (toCell(x + cosine * d, y + sine * d, cell))
+            set(cell, false);
+    }
+    if ((distance < maxDistance) && toCell(x + cosine * distance, y + sine * distance, cell))
+        set(cell, true);
+}
\ No newline at end of file
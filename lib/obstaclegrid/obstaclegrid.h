@@ -0,0 +1,34 @@
+/**
+ * @file obstaclegrid.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Fixed-size occupancy grid of 1 bit per cell, remembering the obstacles found by the sonar.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef OBSTACLEGRID_H
+#define OBSTACLEGRID_H
+
+class ObstacleGrid
+{
+private:
+    static constexpr unsigned char s_size{32}; // Cells per side, the origin in the middle
+    static constexpr unsigned char s_cell{10}; // Cell side (cm): 3.2 m x 3.2 m
+    unsigned char m_cells[s_size * s_size / 8]; // 128 bytes
+
+    bool toCell(float x, float y, unsigned short &cell) const;
+    bool isOccupied(unsigned short cell) const;
+    void set(unsigned short cell, bool occupied);
+
+public:
+    ObstacleGrid();
+    ~ObstacleGrid();
+    void clear();
+    unsigned short count() const;
+    bool isOccupied(float x, float y) const;
+    unsigned short raycast(float x, float y, float heading, unsigned short maxDistance) const;
+    void addReading(float x, float y, float heading, unsigned short distance, unsigned short maxDistance);
+};
+
+#endif
\ No newline at end of file
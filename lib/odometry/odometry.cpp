@@ -0,0 +1,109 @@
+/**
+ * @file odometry.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Dead-reckoning pose estimator driven by the commanded motor speeds.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "odometry.h"
+
+/**
+ * @brief Construct a new Odometry::Odometry object.
+ */
+Odometry::Odometry()
+    : m_x{0}, m_y{0}, m_heading{0}, m_time{0}, m_linearScale{0}, m_turnScale{0}
+{
+}
+
+/**
+ * @brief Destroy the Odometry::Odometry object.
+ */
+Odometry::~Odometry()
+{
+}
+
+/**
+ * @brief Set the pose to the origin: the current position and heading.
+ * @param time Current time (ms).
+ */
+void Odometry::reset(unsigned long time)
+{
+    m_x = 0;
+    m_y = 0;
+    m_heading = 0;
+    m_time = time;
+}
+
+/**
+ * @brief Set the calibrated motion of the robot.
+ * @param linearScale Forward speed per PWM (cm/s).
+ * @param turnScale Turn rate per PWM of speed difference between sides (rad/s).
+ */
+void Odometry::setScales(float linearScale, float turnScale)
+{
+    m_linearScale = linearScale;
+    m_turnScale = turnScale;
+}
+
+/**
+ * @brief Integrate the motion since the last update.
+ * @param time Current time (ms).
+ * @param leftSpeed Left motors speed commanded since the last update (-255..255).
+ * @param rightSpeed Right motors speed commanded since the last update (-255..255).
+ */
+void Odometry::update(unsigned long time, short leftSpeed, short rightSpeed)
+{
+    float dt = (time - m_time) / 1000.0;
+    m_time = time;
+    float distance = (leftSpeed + rightSpeed) / 2.0 * m_linearScale * dt;
+    float turn = (rightSpeed - leftSpeed) / 2.0 * m_turnScale * dt;
+    float heading = m_heading + turn / 2; // Mean heading of the interval
+    m_x += distance * cos(heading);
+    m_y += distance * sin(heading);
+    m_heading += turn;
+    if (m_heading > PI)
+        m_heading -= TWO_PI;
+    else if (m_heading < -PI)
+        m_heading += TWO_PI;
+}
+
+/**
+ * @brief Shift the position, e.g. from an external measurement.
+ * @param dx Shift along the initial heading (cm).
+ * @param dy Shift to the left of the initial heading (cm).
+ */
+void Odometry::correct(float dx, float dy)
+{
+    m_x += dx;
+    m_y += dy;
+}
+
+/**
+ * @brief Get the position along the initial heading.
+ * @return float Position (cm).
+ */
+float Odometry::getX() const
+{
+    return m_x;
+}
+
+/**
+ * @brief Get the position to the left of the initial heading.
+ * @return float Position (cm).
+ */
+float Odometry::getY() const
+{
+    return m_y;
+}
+
+/**
+ * @brief Get the heading from the initial one, positive left.
+ * @return float Heading (rad), -PI..PI.
+ */
+float Odometry::getHeading() const
+{
+    return m_heading;
+}
\ No newline at end of file
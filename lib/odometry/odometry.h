@@ -0,0 +1,35 @@
+/**
+ * @file odometry.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Dead-reckoning pose estimator driven by the commanded motor speeds.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+class Odometry
+{
+private:
+    float m_x;            // Position along the initial heading (cm)
+    float m_y;            // Position to the left of the initial heading (cm)
+    float m_heading;      // Heading from the initial one, positive left (rad)
+    unsigned long m_time; // Time of the last update (ms)
+    float m_linearScale;  // Forward speed per PWM (cm/s)
+    float m_turnScale;    // Turn rate per PWM of speed difference between sides (rad/s)
+
+public:
+    Odometry();
+    ~Odometry();
+    void reset(unsigned long time);
+    void setScales(float linearScale, float turnScale);
+    void update(unsigned long time, short leftSpeed, short rightSpeed);
+    void correct(float dx, float dy);
+    float getX() const;
+    float getY() const;
+    float getHeading() const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+/**
+ * @file rangeestimator.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Alpha-beta estimator of the distance in one sonar direction, fusing pings with the commanded motion.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "rangeestimator.h"
+
+/**
+ * @brief Construct a new RangeEstimator::RangeEstimator object.
+ */
+RangeEstimator::RangeEstimator()
+    : m_distance{0}, m_rateBias{0}, m_time{0}, m_rejected{0}, m_valid{false}
+{
+}
+
+/**
+ * @brief Destroy the RangeEstimator::RangeEstimator object.
+ */
+RangeEstimator::~RangeEstimator()
+{
+}
+
+/**
+ * @brief Forget the estimate, the next ping starts a new one.
+ */
+void RangeEstimator::reset()
+{
+    m_rateBias = 0;
+    m_rejected = 0;
+    m_valid = false;
+}
+
+/**
+ * @brief Return if there is an estimate.
+ * @return true Estimate available.
+ * @return false No valid ping yet.
+ */
+bool RangeEstimator::isValid() const
+{
+    return m_valid;
+}
+
+/**
+ * @brief Return the estimated rate of change of the distance, negative when closing in.
+ * @param commandedRate Rate expected from the commanded motion (cm/s).
+ * @return float Rate (cm/s).
+ */
+float RangeEstimator::getRate(float commandedRate) const
+{
+    return commandedRate + m_rateBias;
+}
+
+/**
+ * @brief Predict the distance at a given time.
+ * @param time Current time (ms).
+ * @param commandedRate Rate expected from the commanded motion since the last ping (cm/s).
+ * @param maxDistance Distance returned without estimate.
+ * @return unsigned short Predicted distance (cm), limited to 0..maxDistance.
+ */
+unsigned short RangeEstimator::predict(unsigned long time, float commandedRate, unsigned short maxDistance) const
+{
+    if (!m_valid)
+        return maxDistance;
+    float distance = m_distance + getRate(commandedRate) * (time - m_time) / 1000.0;
+    if (distance <= 0)
+        return 0;
+    if (distance >= maxDistance)
+        return maxDistance;
+    return static_cast<unsigned short>(distance + 0.5);
+}
+
+/**
+ * @brief Correct the estimate with a new ping. Timeouts (maxDistance) and pings far beyond the
+ * prediction are rejected as outliers, unless they repeat. Pings far closer than the prediction
+ * are an obstacle appearing and restart the estimate at once.
+ * @param distance Measured distance (cm).
+ * @param time Time of the ping (ms).
+ * @param commandedRate Rate expected from the commanded motion since the last ping (cm/s).
+ * @param maxDistance Distance returned by the sensor on a missed echo.
+ * @return true Ping used.
+ * @return false Ping rejected.
+ */
+bool RangeEstimator::update(unsigned short distance, unsigned long time, float commandedRate, unsigned short maxDistance)
+{
+    if (distance >= maxDistance) // Timeout, nothing in range or a missed echo
+    {
+        if (++m_rejected >= s_maxRejected) // Nothing in range anymore
+            reset();
+        return false;
+    }
+    if (m_valid && (m_rejected < s_maxRejected))
+    {
+        float dt = (time - m_time) / 1000.0;
+        float predicted = m_distance + getRate(commandedRate) * dt;
+        float innovation = distance - predicted;
+        if (innovation > s_gate) // Outlier: a missed echo or the edge of the object
+        {
+            ++m_rejected;
+            return false;
+        }
+        if (innovation >= -s_gate)
+        {
+            m_rejected = 0;
+            m_distance = predicted + s_alpha * innovation;
+            if (dt > 0)
+                m_rateBias = constrain(m_rateBias + s_beta * innovation / dt, -s_maxRateBias, s_maxRateBias);
+            m_time = time;
+            return true;
+        }
+    }
+
+    // Start again with this ping: no estimate, repeated outliers or a closer obstacle
+    m_distance = distance;
+    m_rateBias = 0;
+    m_time = time;
+    m_rejected = 0;
+    m_valid = true;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+/**
+ * @file rangeestimator.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Alpha-beta estimator of the distance in one sonar direction, fusing pings with the commanded motion.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef RANGEESTIMATOR_H
+#define RANGEESTIMATOR_H
+
+class RangeEstimator
+{
+private:
+    float m_distance;        // Estimated distance at m_time (cm)
+    float m_rateBias;        // Estimated rate not explained by the commanded motion (cm/s)
+    unsigned long m_time;    // Time of the last estimate (ms)
+    unsigned char m_rejected; // Consecutive rejected pings
+    bool m_valid;
+    static constexpr float s_alpha{0.5};        // Distance correction gain
+    static constexpr float s_beta{0.1};         // Rate correction gain
+    static constexpr float s_gate{30};          // Maximum innovation accepted, closer pings always are (cm)
+    static constexpr float s_maxRateBias{100};  // Limit of the rate bias (cm/s)
+    static constexpr unsigned char s_maxRejected{2}; // Rejected pings before restarting with a new one
+
+public:
+    RangeEstimator();
+    ~RangeEstimator();
+    void reset();
+    bool isValid() const;
+    float getRate(float commandedRate) const;
+    unsigned short predict(unsigned long time, float commandedRate, unsigned short maxDistance) const;
+    bool update(unsigned short distance, unsigned long time, float commandedRate, unsigned short maxDistance);
+};
+
+#endif
\ No newline at end of file
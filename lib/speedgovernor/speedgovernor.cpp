@@ -0,0 +1,87 @@
+/**
+ * @file speedgovernor.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Forward speed limit keeping the robot able to stop before the obstacle in front.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "speedgovernor.h"
+
+/**
+ * @brief Construct a new SpeedGovernor::SpeedGovernor object.
+ * @param linearScale Forward speed per PWM (cm/s).
+ * @param deceleration Braking deceleration once the motors are stopped (cm/s2).
+ * @param reaction Time from a reading to the motors braking (ms).
+ * @param ramp Speed increase per second when the path clears (PWM).
+ */
+SpeedGovernor::SpeedGovernor(float linearScale, unsigned short deceleration, unsigned short reaction, unsigned short ramp)
+    : m_speed{0}, m_speedTime{0},
+      m_linearScale{linearScale}, m_deceleration{static_cast<float>(deceleration)}, m_reaction{reaction / 1000.0f}, m_ramp{static_cast<float>(ramp)}
+{
+}
+
+/**
+ * @brief Destroy the SpeedGovernor::SpeedGovernor object.
+ */
+SpeedGovernor::~SpeedGovernor()
+{
+}
+
+/**
+ * @brief Start the next ramp from the minimum speed.
+ */
+void SpeedGovernor::reset()
+{
+    m_speed = 0;
+}
+
+/**
+ * @brief Time to collision at a closing rate, e.g. the estimate of the front RangeEstimator.
+ * @param distance Current front distance (cm).
+ * @param rate Change of the front distance (cm/s), negative closing in.
+ * @return unsigned short Time to collision (ms), 0xFFFF if not closing in.
+ */
+unsigned short SpeedGovernor::getTimeToCollision(unsigned short distance, float rate)
+{
+    if (rate >= 0)
+        return 0xFFFF;
+    if (distance == 0)
+        return 0;
+    float ttc = -static_cast<float>(distance) * 1000 / rate;
+    return (ttc < 0xFFFF) ? static_cast<unsigned short>(ttc) : 0xFFFF;
+}
+
+/**
+ * @brief Highest forward speed from which the robot stops margin cm before the obstacle, braking
+ * after the reaction time: v * t + v^2 / (2 * a) = free distance. An obstacle approaching by itself
+ * takes its share of the free distance. Decreases are immediate and increases limited to the ramp.
+ * @param time Current time (ms).
+ * @param distance Current front distance (cm).
+ * @param approach Obstacle own approach speed, the closing rate not explained by the robot motion (cm/s).
+ * @param margin Distance to keep to the obstacle when stopped (cm).
+ * @param minSpeed Lowest moving speed: the ramp starts there.
+ * @param maxSpeed Highest speed.
+ * @return unsigned char Governed speed, 0 if the robot cannot stop in time even at minSpeed.
+ */
+unsigned char SpeedGovernor::limit(unsigned long time, unsigned short distance, float approach, unsigned short margin, unsigned char minSpeed, unsigned char maxSpeed)
+{
+    approach = constrain(approach, 0, s_maxApproach);
+    float free = static_cast<float>(distance) - margin - approach * m_reaction;
+    float target{0};
+    if (free > 0)
+        target = m_deceleration * (sqrt(m_reaction * m_reaction + 2 * free / m_deceleration) - m_reaction) / m_linearScale;
+    target = min(target, static_cast<float>(maxSpeed));
+
+    unsigned long dt = time - m_speedTime;
+    m_speedTime = time;
+    if (target < minSpeed)
+        m_speed = 0;
+    else if (m_speed < minSpeed) // Starting
+        m_speed = minSpeed;
+    else
+        m_speed = min(target, m_speed + m_ramp * dt / 1000);
+    return static_cast<unsigned char>(m_speed);
+}
\ No newline at end of file
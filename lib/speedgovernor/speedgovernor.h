@@ -0,0 +1,32 @@
+/**
+ * @file speedgovernor.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Forward speed limit keeping the robot able to stop before the obstacle in front.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SPEEDGOVERNOR_H
+#define SPEEDGOVERNOR_H
+
+class SpeedGovernor
+{
+private:
+    float m_speed;            // Governed speed, ramped (PWM)
+    unsigned long m_speedTime; // Time of the last limit (ms)
+    float m_linearScale;      // Forward speed per PWM (cm/s)
+    float m_deceleration;     // Braking deceleration (cm/s2)
+    float m_reaction;         // Time from a reading to the motors braking (s)
+    float m_ramp;             // Speed increase per second (PWM)
+    static constexpr float s_maxApproach{100};  // Limit of the obstacle own approach speed (cm/s)
+
+public:
+    SpeedGovernor(float linearScale, unsigned short deceleration, unsigned short reaction, unsigned short ramp);
+    ~SpeedGovernor();
+    void reset();
+    static unsigned short getTimeToCollision(unsigned short distance, float rate);
+    unsigned char limit(unsigned long time, unsigned short distance, float approach, unsigned short margin, unsigned char minSpeed, unsigned char maxSpeed);
+};
+
+#endif
\ No newline at end of file
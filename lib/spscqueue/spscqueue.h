@@ -0,0 +1,78 @@
+/**
+ * @file spscqueue.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Lock-free single-producer single-consumer queue to exchange data between an interrupt and the main program.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+/**
+ * @brief Fixed size FIFO. Only the producer writes m_head and only the consumer writes m_tail,
+ * both single bytes, so no interrupt needs to be disabled. It holds size - 1 elements.
+ * @tparam T Element type.
+ * @tparam size Number of slots, a power of 2 up to 128.
+ */
+template <typename T, unsigned char size>
+class SpscQueue
+{
+    static_assert((size >= 2) && (size <= 128) && ((size & (size - 1)) == 0), "Size must be a power of 2 up to 128");
+
+private:
+    T m_buffer[size];
+    volatile unsigned char m_head; // Next slot to write
+    volatile unsigned char m_tail; // Next slot to read
+
+public:
+    SpscQueue() : m_head{0}, m_tail{0} {}
+
+    /**
+     * @brief Add an element. Producer side only.
+     * @param element Element.
+     * @return true Element added.
+     * @return false Queue full.
+     */
+    bool push(const T &element)
+    {
+        unsigned char head = m_head;
+        unsigned char next = (head + 1) & (size - 1);
+        if (next == m_tail)
+            return false;
+        m_buffer[head] = element;
+        asm volatile("" ::: "memory"); // Element written before it is published
+        m_head = next;
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest element. Consumer side only.
+     * @param element Element read.
+     * @return true Element read.
+     * @return false Queue empty.
+     */
+    bool pop(T &element)
+    {
+        unsigned char tail = m_tail;
+        if (tail == m_head)
+            return false;
+        element = m_buffer[tail];
+        asm volatile("" ::: "memory"); // Element read before the slot is released
+        m_tail = (tail + 1) & (size - 1);
+        return true;
+    }
+
+    /**
+     * @brief Return if the queue is empty. Either side.
+     * @return true No elements.
+     * @return false Some elements.
+     */
+    bool isEmpty() const
+    {
+        return m_head == m_tail;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -8,6 +8,7 @@
  */
 
 #include <Arduino.h>
+#include "flightrecorder.h"
 #include "ultrasonic.h"
 
 /**
@@ -45,8 +46,13 @@ unsigned short Ultrasonic::getDistance(unsigned short maxDistance)
     // interrupts();
 
     if (duration == 0)
+    {
+        FlightRecorder::log(FlightEvent::SONAR, 0, maxDistance, 0);
         return maxDistance;
+    }
 
     // Calculate distance (cm)
-    return static_cast<unsigned short>(duration * s_halfSpeedOfSound);
+    unsigned short distance = static_cast<unsigned short>(duration * s_halfSpeedOfSound);
+    FlightRecorder::log(FlightEvent::SONAR, 0, distance, static_cast<short>(duration));
+    return distance;
 }
\ No newline at end of file
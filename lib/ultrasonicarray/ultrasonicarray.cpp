@@ -0,0 +1,289 @@
+/**
+ * @file ultrasonicarray.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Library for several fixed HC-SR04, pinged in groups without blocking and timed by interrupts.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "clock.h"
+#include "controltick.h"
+#include "flightrecorder.h"
+#include "ultrasonicarray.h"
+
+unsigned char UltrasonicArray::s_count{0};
+unsigned char UltrasonicArray::s_triggerPins[s_maxSensors]{};
+unsigned char UltrasonicArray::s_echoBits[s_maxSensors]{};
+unsigned char UltrasonicArray::s_groups[s_maxSensors]{};
+unsigned char UltrasonicArray::s_groupCount{0};
+unsigned char UltrasonicArray::s_group{0};
+unsigned short UltrasonicArray::s_maxDistance{0};
+unsigned long UltrasonicArray::s_window{0};
+unsigned long UltrasonicArray::s_quietTime{0};
+bool UltrasonicArray::s_inFlight{false};
+unsigned long UltrasonicArray::s_start{0};
+volatile unsigned char UltrasonicArray::s_echoMask{0};
+volatile unsigned char UltrasonicArray::s_lastPins{0};
+volatile unsigned char UltrasonicArray::s_risen{0};
+volatile unsigned char UltrasonicArray::s_done{0};
+volatile unsigned short UltrasonicArray::s_rise[s_maxSensors]{};
+volatile unsigned short UltrasonicArray::s_duration[s_maxSensors]{};
+unsigned short UltrasonicArray::s_distances[s_maxSensors]{};
+unsigned long UltrasonicArray::s_times[s_maxSensors]{};
+unsigned char UltrasonicArray::s_new{0};
+
+ISR(PCINT1_vect)
+{
+    UltrasonicArray::echo();
+}
+
+/**
+ * @brief Add a sensor. Sensors of the same group are pinged at the same time, so they must not hear
+ * each other, e.g. looking to opposite sides. Groups are pinged in turn.
+ * @param triggerPin Trigger pin.
+ * @param echoPin Echo pin, it must be in port C (A0-A5).
+ * @param group Group.
+ * @return true Sensor added, its index is the number of sensors added before.
+ * @return false Too many sensors or echo pin out of port C.
+ */
+bool UltrasonicArray::add(unsigned char triggerPin, unsigned char echoPin, unsigned char group)
+{
+    if ((s_count >= s_maxSensors) || (digitalPinToPCICRbit(echoPin) != PCIE1))
+        return false;
+    s_triggerPins[s_count] = triggerPin;
+    s_echoBits[s_count] = digitalPinToBitMask(echoPin);
+    s_groups[s_count] = group;
+    s_distances[s_count] = 0;
+    if (group >= s_groupCount)
+        s_groupCount = group + 1;
+    ++s_count;
+    pinMode(triggerPin, OUTPUT);
+    digitalWrite(triggerPin, LOW);
+    pinMode(echoPin, INPUT);
+    return true;
+}
+
+/**
+ * @brief Start pinging. The echoes are timed with Timer1, started by the Servo library; it is
+ * started the same way otherwise.
+ * @param maxDistance Maximum measured distance, up to 340 cm (Timer1 frame).
+ * @param quietTime Time between groups for the echoes to fade away (ms).
+ */
+void UltrasonicArray::begin(unsigned short maxDistance, unsigned short quietTime)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) == 0) // Timer1 stopped: normal mode, prescaler 8
+        {
+            TCCR1A = 0;
+            TCCR1B = _BV(CS11);
+        }
+        PCMSK1 = 0;
+        PCICR |= _BV(PCIE1);
+    }
+    s_maxDistance = maxDistance;
+    s_window = s_echoDelay + static_cast<unsigned long>(maxDistance / s_halfSpeedOfSound);
+    s_quietTime = static_cast<unsigned long>(quietTime) * 1000;
+    s_group = s_groupCount - 1; // First group next
+    s_inFlight = false;
+    s_start = Clock::micros() - s_quietTime;
+}
+
+/**
+ * @brief Sensors of a group.
+ * @param group Group.
+ * @return unsigned char Bit per sensor.
+ */
+unsigned char UltrasonicArray::groupMask(unsigned char group)
+{
+    unsigned char mask{0};
+    for (unsigned char i{0}; i < s_count; ++i)
+        if (s_groups[i] == group)
+            mask |= _BV(i);
+    return mask;
+}
+
+/**
+ * @brief Ping all the sensors of a group and watch their echo pins.
+ * @param group Group.
+ */
+void UltrasonicArray::trigger(unsigned char group)
+{
+    unsigned char echoMask{0};
+    for (unsigned char i{0}; i < s_count; ++i)
+        if (s_groups[i] == group)
+            echoMask |= s_echoBits[i];
+    s_group = group;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        s_risen = 0;
+        s_done = 0;
+        s_lastPins = PINC;
+        s_echoMask = echoMask;
+        PCIFR = _BV(PCIF1); // Clear old changes
+        PCMSK1 |= echoMask;
+    }
+    for (unsigned char i{0}; i < s_count; ++i)
+        if (s_groups[i] == group)
+            digitalWrite(s_triggerPins[i], HIGH);
+    delayMicroseconds(10);
+    for (unsigned char i{0}; i < s_count; ++i)
+        if (s_groups[i] == group)
+            digitalWrite(s_triggerPins[i], LOW);
+    s_inFlight = true;
+    s_start = Clock::micros();
+}
+
+/**
+ * @brief Stop watching the echoes of the group in flight and store the distances, the maximum
+ * distance if there was no echo.
+ */
+void UltrasonicArray::finish()
+{
+    unsigned char done;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        PCMSK1 &= ~s_echoMask;
+        s_echoMask = 0;
+        done = s_done;
+    }
+    unsigned long time = Clock::millis();
+    for (unsigned char i{0}; i < s_count; ++i)
+    {
+        if (s_groups[i] != s_group)
+            continue;
+        s_distances[i] = s_maxDistance;
+        if (done & _BV(i)) // Not written by the interrupt any more
+        {
+            unsigned short distance = static_cast<unsigned short>(s_duration[i] / 2 * s_halfSpeedOfSound); // Timer ticks of 0.5 us
+            if (distance < s_maxDistance)
+                s_distances[i] = distance;
+        }
+        s_times[i] = time;
+        s_new |= _BV(i);
+        FlightRecorder::log(FlightEvent::SONAR, i + 1, s_distances[i], (done & _BV(i)) ? static_cast<short>(s_duration[i] / 2) : 0);
+    }
+    s_inFlight = false;
+    s_start = Clock::micros();
+}
+
+/**
+ * @brief Collect the echoes of the group in flight and ping the next group after the quiet time.
+ * Call it as often as possible.
+ * @return true Distances of a group stored.
+ * @return false Nothing new.
+ */
+bool UltrasonicArray::update()
+{
+    if (s_count == 0)
+        return false;
+    bool finished{false};
+    unsigned long now = Clock::micros();
+    if (s_inFlight)
+    {
+        unsigned char mask = groupMask(s_group);
+        if (((s_done & mask) != mask) && ((now - s_start) < s_window))
+            return false;
+        finish();
+        finished = true;
+        now = s_start;
+    }
+    if ((now - s_start) < s_quietTime)
+        return finished;
+
+    unsigned char group = (s_group + 1) % s_groupCount;
+    unsigned char pins = PINC;
+    for (unsigned char i{0}; i < s_count; ++i)
+    {
+        if ((s_groups[i] == group) && (pins & s_echoBits[i])) // Still waiting for a lost echo, the trigger would be ignored
+        {
+            s_group = group; // Try the next group
+            return finished;
+        }
+    }
+    trigger(group);
+    return finished;
+}
+
+/**
+ * @brief Wait for the echoes of the group in flight, before pinging another sensor which could hear them.
+ */
+void UltrasonicArray::wait()
+{
+    if (!s_inFlight)
+        return;
+    unsigned char mask = groupMask(s_group);
+    while (((s_done & mask) != mask) && ((Clock::micros() - s_start) < s_window))
+        ;
+    finish();
+}
+
+/**
+ * @brief Restart the quiet time, after pinging another sensor which the next group could hear.
+ */
+void UltrasonicArray::hold()
+{
+    if (!s_inFlight)
+        s_start = Clock::micros();
+}
+
+/**
+ * @brief Whether a sensor has a distance not read yet.
+ * @param sensor Sensor index.
+ * @return true New distance.
+ * @return false Already read.
+ */
+bool UltrasonicArray::isNew(unsigned char sensor)
+{
+    return s_new & _BV(sensor);
+}
+
+/**
+ * @brief Get the last distance of a sensor, marking it as read.
+ * @param sensor Sensor index.
+ * @return unsigned short Distance in cm.
+ */
+unsigned short UltrasonicArray::getDistance(unsigned char sensor)
+{
+    s_new &= ~_BV(sensor);
+    return s_distances[sensor];
+}
+
+/**
+ * @brief Get the time of the last distance of a sensor.
+ * @param sensor Sensor index.
+ * @return unsigned long Time (ms).
+ */
+unsigned long UltrasonicArray::getTime(unsigned char sensor)
+{
+    return s_times[sensor];
+}
+
+/**
+ * @brief Time the echo pulses of the group in flight. Called from the pin change interrupt.
+ */
+void UltrasonicArray::echo()
+{
+    unsigned short now = TCNT1;
+    unsigned char pins = PINC;
+    unsigned char changed = (pins ^ s_lastPins) & s_echoMask;
+    s_lastPins = pins;
+    for (unsigned char i{0}; i < s_count; ++i)
+    {
+        if (!(changed & s_echoBits[i]))
+            continue;
+        if (pins & s_echoBits[i]) // Echo started
+        {
+            s_rise[i] = now;
+            s_risen |= _BV(i);
+        }
+        else if (s_risen & _BV(i))
+        {
+            s_duration[i] = ControlTick::elapsed(now, s_rise[i]);
+            s_done |= _BV(i);
+        }
+    }
+}
\ No newline at end of file
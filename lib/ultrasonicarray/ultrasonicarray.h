@@ -0,0 +1,60 @@
+/**
+ * @file ultrasonicarray.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Library for several fixed HC-SR04, pinged in groups without blocking and timed by interrupts.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef ULTRASONICARRAY_H
+#define ULTRASONICARRAY_H
+
+#include <Arduino.h>
+
+class UltrasonicArray
+{
+public:
+    static constexpr unsigned char s_maxSensors{4};
+
+private:
+    static constexpr float s_halfSpeedOfSound{0.0343 / 2}; // Half of speed of sound in cm/us
+    static constexpr unsigned short s_echoDelay{1000};      // Time from the trigger to the echo start, at most (us)
+    static unsigned char s_count;
+    static unsigned char s_triggerPins[s_maxSensors];
+    static unsigned char s_echoBits[s_maxSensors];  // Echo pins bits in port C
+    static unsigned char s_groups[s_maxSensors];    // Sensors of a group are pinged together
+    static unsigned char s_groupCount;
+    static unsigned char s_group;                   // Group in flight or last pinged
+    static unsigned short s_maxDistance;
+    static unsigned long s_window;                  // Time waiting for the echoes (us)
+    static unsigned long s_quietTime;               // Time between groups for the echoes to fade away (us)
+    static bool s_inFlight;
+    static unsigned long s_start;                   // Group trigger or end of the last one (us)
+    static volatile unsigned char s_echoMask;       // Port C bits watched by the interrupt
+    static volatile unsigned char s_lastPins;
+    static volatile unsigned char s_risen;          // Bit per sensor: echo started
+    static volatile unsigned char s_done;           // Bit per sensor: echo finished
+    static volatile unsigned short s_rise[s_maxSensors];     // Timer1 ticks
+    static volatile unsigned short s_duration[s_maxSensors]; // Timer1 ticks
+    static unsigned short s_distances[s_maxSensors];
+    static unsigned long s_times[s_maxSensors];     // Time of the last distances (ms)
+    static unsigned char s_new;                     // Bit per sensor: distance not read yet
+
+    static unsigned char groupMask(unsigned char group);
+    static void trigger(unsigned char group);
+    static void finish();
+
+public:
+    static bool add(unsigned char triggerPin, unsigned char echoPin, unsigned char group);
+    static void begin(unsigned short maxDistance, unsigned short quietTime);
+    static bool update();
+    static void wait();
+    static void hold();
+    static bool isNew(unsigned char sensor);
+    static unsigned short getDistance(unsigned char sensor);
+    static unsigned long getTime(unsigned char sensor);
+    static void echo();
+};
+
+#endif
\ No newline at end of file
@@ -2,21 +2,29 @@
  * @file bluetooth.cpp
  * @author José Ángel Sánchez (https://github.com/gelanchez)
  * @brief Library for receiving and processing the data from the serial bluetooth JSON.
- * @version 1.2.0
- * @date 2021-04-18
+ * @version 1.3.0
+ * @date 2026-10-19
  * @copyright GPL-3.0
  */
 
 #include <ArduinoJson.h>
+#include "clock.h"
 #include "bluetooth.h"
 #include "constants.h"
+#include "controltick.h"
+#include "flightrecorder.h"
+#include "parameters.h"
+#include "routes.h"
 
 /**
  * @brief Construct a new Bluetooth::Bluetooth object.
  */
 Bluetooth::Bluetooth()
-    : m_data{""}, m_mode{RobotMode::REMOTECONTROL}, // Default robot mode
-      m_order{Order::STOP}, m_speed{0}
+    : m_frame{}, m_frameLength{0}, m_vectorFrame{}, m_vectorLength{0}, m_mode{RobotMode::REMOTECONTROL}, // Default robot mode
+      m_order{Order::STOP}, m_speed{0}, m_linear{0}, m_angular{0}, m_nextOrder{Order::STOP}, m_nextSpeed{0}, m_nextLinear{0}, m_nextAngular{0},
+      m_deferredOrder{false}, m_newOrder{false}, m_stopReceived{false}, m_modeChanged{false}, m_mapRequest{false}, m_mapClear{false}, m_lapRequest{false}, m_lapReset{false}, m_batteryRequest{false},
+      m_receivedFrames{0}, m_coalescedFrames{0}, m_droppedFrames{0}, m_malformedFrames{0},
+      m_linkStats{}, m_frameTime{0}, m_lastFrameTime{0}, m_lastDrainTime{0}
 {
 }
 
@@ -27,6 +35,17 @@ Bluetooth::~Bluetooth()
 {
 }
 
+/**
+ * @brief Count a valid frame and its gap from the previous one.
+ */
+void Bluetooth::countFrame()
+{
+    ++m_receivedFrames;
+    if (m_receivedFrames > 1)
+        updateStats(m_linkStats.gapAverage, m_linkStats.gapMax, (m_frameTime - m_lastFrameTime) / 1000);
+    m_lastFrameTime = m_frameTime;
+}
+
 /**
  * @brief Decode Elegoo JSON object, setting the struct data.
  * Modes in bluetooth (Elegoo specifications):
@@ -34,91 +53,183 @@ Bluetooth::~Bluetooth()
  * {"N":3,"D1":1} line tracking.
  * {"N":3,"D1":2} obstacle avoidance.
  * {"N":2,"D1":1..9} joystick.
+ * Link diagnostics (not Elegoo):
+ * {"N":110,"D1":sequence,"D2":previous RTT (ms)} ping, echoed with the receive and process times.
+ * {"N":111} link statistics, {"N":111,"D1":1} to reset them afterwards.
+ * Parameters (not Elegoo), D1 is the Param index:
+ * {"N":120,"D1":index} read, {"N":121,"D1":index,"D2":value} write in RAM.
+ * {"N":122} save in EEPROM, {"N":123} restore the defaults in RAM.
+ * {"N":130} calibration mode (not Elegoo).
+ * {"N":112} control tick statistics, {"N":140} flight recorder, {"N":150} obstacle map, {"N":160} laps,
+ * {"N":170} battery (not Elegoo).
  */
 void Bluetooth::decodeElegooJSON()
 {
-    DeserializationError error = deserializeJson(m_elegooDoc, m_data);
-    if (!error)
+    DeserializationError error = deserializeJson(m_elegooDoc, static_cast<const char *>(m_frame), m_frameLength);
+    if (error)
     {
-        unsigned char N = m_elegooDoc["N"];
-        unsigned char D1;
-        switch (N) // See Elegoo specifications
+        ++m_malformedFrames;
+        return;
+    }
+    countFrame();
+
+    unsigned char N = m_elegooDoc["N"];
+    unsigned char D1;
+    switch (N) // See Elegoo specifications
+    {
+    case 2: // remoteControlMode, set by the order
+    {
+        D1 = m_elegooDoc["D1"];
+        Order order;
+        switch (D1)
         {
-        case 2: // remoteControlMode
-            m_mode = RobotMode::REMOTECONTROL;
-            D1 = m_elegooDoc["D1"];
-            m_speed = m_elegooDoc["D2"];
-            switch (D1)
-            {
-            case 1:
-                m_order = Order::LEFT;
-                return;
-            case 2:
-                m_order = Order::RIGHT;
-                return;
-            case 3:
-                m_order = Order::FORWARD;
-                return;
-            case 4:
-                m_order = Order::BACKWARD;
-                return;
-            case 5:
-                m_order = Order::STOP;
-                return;
-            case 6:
-                m_order = Order::FORWARD_LEFT;
-                return;
-            case 7:
-                m_order = Order::BACKWARD_LEFT;
-                return;
-            case 8:
-                m_order = Order::FORWARD_RIGHT;
-                return;
-            case 9:
-                m_order = Order::BACKWARD_RIGHT;
-                return;
-            default:
-                m_order = Order::UNKNOWN;
-                return;
-            }
-        case 3: // lineTrackingMode or obstacleAvoidanceMode
-            D1 = m_elegooDoc["D1"];
-            switch (D1)
-            {
-            case 1:
-                if (m_mode != RobotMode::LINETRACKING)
-                    m_mode = RobotMode::LINETRACKING;
-                return;
-            case 2:
-                if (m_mode != RobotMode::OBSTACLEAVOIDANCE)
-                    m_mode = RobotMode::OBSTACLEAVOIDANCE;
-                return;
-            default:
-                return;
-            }
-        case 5: // IRControlMode mode activation or deactivation (deactivate other modes)
-            if (m_mode == RobotMode::REMOTECONTROL)
-                m_mode = RobotMode::IRCONTROL;
-            else
-                m_mode = RobotMode::REMOTECONTROL;
+        case 1:
+            order = Order::LEFT;
+            break;
+        case 2:
+            order = Order::RIGHT;
+            break;
+        case 3:
+            order = Order::FORWARD;
+            break;
+        case 4:
+            order = Order::BACKWARD;
+            break;
+        case 5:
+            order = Order::STOP;
+            break;
+        case 6:
+            order = Order::FORWARD_LEFT;
+            break;
+        case 7:
+            order = Order::BACKWARD_LEFT;
+            break;
+        case 8:
+            order = Order::FORWARD_RIGHT;
+            break;
+        case 9:
+            order = Order::BACKWARD_RIGHT;
+            break;
+        default:
+            order = Order::UNKNOWN;
+            break;
+        }
+        setOrder(order, m_elegooDoc["D2"]);
+        return;
+    }
+    case 3: // lineTrackingMode or obstacleAvoidanceMode
+        D1 = m_elegooDoc["D1"];
+        switch (D1)
+        {
+        case 1:
+            changeMode(RobotMode::LINETRACKING);
             return;
-        case 100: // parkMode activation
-            m_mode = RobotMode::PARK;
+        case 2:
+            changeMode(RobotMode::OBSTACLEAVOIDANCE);
             return;
         default:
-            m_mode = RobotMode::REMOTECONTROL;
             return;
         }
+    case 5: // IRControlMode mode activation or deactivation (deactivate other modes)
+        changeMode((m_mode == RobotMode::REMOTECONTROL) ? RobotMode::IRCONTROL : RobotMode::REMOTECONTROL);
+        return;
+    case 100: // parkMode activation
+        changeMode(RobotMode::PARK);
+        return;
+    case 130: // calibrationMode activation
+        changeMode(RobotMode::CALIBRATION);
+        return;
+    case 110: // Ping
+    {
+        unsigned long rtt = m_elegooDoc["D2"];
+        if (rtt > 0)
+            updateStats(m_linkStats.rttAverage, m_linkStats.rttMax, rtt);
+        replyPing(m_elegooDoc["D1"], m_frameTime - m_lastDrainTime);
+        return;
+    }
+    case 120: // Read parameter
+        D1 = m_elegooDoc["D1"];
+        replyParameter(D1, D1 < static_cast<unsigned char>(Param::count));
+        return;
+    case 121: // Write parameter
+        D1 = m_elegooDoc["D1"];
+        replyParameter(D1, Parameters::set(static_cast<Param>(D1), m_elegooDoc["D2"]));
+        return;
+    case 122: // Save parameters
+        Parameters::save();
+        replyParameter(static_cast<unsigned char>(Param::count), true);
+        return;
+    case 123: // Default parameters
+        Parameters::reset();
+        replyParameter(static_cast<unsigned char>(Param::count), true);
+        return;
+    case 180: // Read route
+        replyRoute(true);
+        return;
+    case 181: // Write and save route
+    {
+        bool valid = Routes::set(m_elegooDoc["D2"], m_elegooDoc["D1"]);
+        if (valid)
+            Routes::save();
+        replyRoute(valid);
+        return;
+    }
+    case 111: // Link statistics
+        replyStats();
+        D1 = m_elegooDoc["D1"];
+        if (D1 == 1)
+            resetStats();
+        return;
+    case 112: // Control tick statistics
+        replyTickStats();
+        D1 = m_elegooDoc["D1"];
+        if (D1 == 1)
+            ControlTick::resetStats();
+        return;
+    case 150: // Obstacle map report
+        D1 = m_elegooDoc["D1"];
+        m_mapRequest = true;
+        m_mapClear = (D1 == 1);
+        return;
+    case 160: // Lap statistics report
+        D1 = m_elegooDoc["D1"];
+        m_lapRequest = true;
+        m_lapReset = (D1 == 1);
+        return;
+    case 170: // Battery state report
+        m_batteryRequest = true;
+        return;
+    case 140: // Flight recorder dump
+        FlightRecorder::requestStream(); // Sent by the main loop, one frame per pass
+        return;
+    default:
+        changeMode(RobotMode::REMOTECONTROL);
+        return;
     }
 }
 
 /**
- * @brief Return latest bluetooth data.
- * @return String bluetooth data.
+ * @brief Decode a binary vector frame {0xA5, linear, angular, checksum}, 4 bytes instead of a
+ * JSON joystick frame. Linear and angular are signed bytes, -127..127 for full speed backward..forward
+ * and right..left. The checksum makes the sum of the 4 bytes 0. Both velocities 0 is a STOP.
  */
-String Bluetooth::getData() const
+void Bluetooth::decodeVector()
 {
-    return m_data;
+    unsigned char sum{0};
+    for (unsigned char i{0}; i < s_vectorSize; ++i)
+        sum += m_vectorFrame[i];
+    if (sum != 0)
+    {
+        ++m_malformedFrames;
+        return;
+    }
+    countFrame();
+    signed char linear = static_cast<signed char>(m_vectorFrame[1]);
+    signed char angular = static_cast<signed char>(m_vectorFrame[2]);
+    if ((linear == 0) && (angular == 0))
+        setOrder(Order::STOP, 0);
+    else
+        setOrder(Order::VECTOR, 0, linear, angular);
 }
 
 /**
@@ -130,6 +241,58 @@ RobotMode Bluetooth::getMode() const
     return m_mode;
 }
 
+/**
+ * @brief Set the robot mode, used to leave the modes which only run once.
+ * @param mode RobotMode.
+ */
+void Bluetooth::setMode(RobotMode mode)
+{
+    m_mode = mode;
+}
+
+/**
+ * @brief Return and clear a pending obstacle map report request.
+ * @param clear Forget the obstacles after the report.
+ * @return true Report requested.
+ * @return false No request.
+ */
+bool Bluetooth::takeMapRequest(bool &clear)
+{
+    if (!m_mapRequest)
+        return false;
+    m_mapRequest = false;
+    clear = m_mapClear;
+    return true;
+}
+
+/**
+ * @brief Return and clear a pending lap statistics request.
+ * @param reset Forget the laps after the report.
+ * @return true Report requested.
+ * @return false No request.
+ */
+bool Bluetooth::takeLapRequest(bool &reset)
+{
+    if (!m_lapRequest)
+        return false;
+    m_lapRequest = false;
+    reset = m_lapReset;
+    return true;
+}
+
+/**
+ * @brief Return and clear a pending battery state request.
+ * @return true Report requested.
+ * @return false No request.
+ */
+bool Bluetooth::takeBatteryRequest()
+{
+    if (!m_batteryRequest)
+        return false;
+    m_batteryRequest = false;
+    return true;
+}
+
 /**
  * @brief Return remote order.
  * @return Order.
@@ -149,18 +312,321 @@ unsigned short Bluetooth::getSpeed() const
 }
 
 /**
- * @brief Receive bluetooth data from Serial.
+ * @brief Return the requested linear velocity of Order::VECTOR.
+ * @return signed char Linear velocity, -127..127 backward..forward.
  */
-void Bluetooth::receiveData()
+signed char Bluetooth::getLinear() const
+{
+    return m_linear;
+}
+
+/**
+ * @brief Return the requested angular velocity of Order::VECTOR.
+ * @return signed char Angular velocity, -127..127 right..left.
+ */
+signed char Bluetooth::getAngular() const
+{
+    return m_angular;
+}
+
+/**
+ * @brief Return the number of valid frames received.
+ * @return unsigned short Received frames.
+ */
+unsigned short Bluetooth::getReceivedFrames() const
+{
+    return m_receivedFrames;
+}
+
+/**
+ * @brief Return the number of joystick orders superseded by a newer one before being applied.
+ * @return unsigned short Coalesced frames.
+ */
+unsigned short Bluetooth::getCoalescedFrames() const
 {
-    m_data = "";
-    while ((Serial.available() > 0) && (m_data.endsWith("}") == false))
+    return m_coalescedFrames;
+}
+
+/**
+ * @brief Return the number of frames lost for being too long.
+ * @return unsigned short Dropped frames.
+ */
+unsigned short Bluetooth::getDroppedFrames() const
+{
+    return m_droppedFrames;
+}
+
+/**
+ * @brief Return the number of frames which could not be decoded.
+ * @return unsigned short Malformed frames.
+ */
+unsigned short Bluetooth::getMalformedFrames() const
+{
+    return m_malformedFrames;
+}
+
+/**
+ * @brief Return the rolling link-quality statistics.
+ * @return const LinkStats& Statistics.
+ */
+const LinkStats &Bluetooth::getLinkStats() const
+{
+    return m_linkStats;
+}
+
+/**
+ * @brief Reset the frame counters and the link-quality statistics.
+ */
+void Bluetooth::resetStats()
+{
+    m_receivedFrames = 0;
+    m_coalescedFrames = 0;
+    m_droppedFrames = 0;
+    m_malformedFrames = 0;
+    m_linkStats = LinkStats{};
+}
+
+/**
+ * @brief Echo a ping with the time the frame was read and the time it was processed.
+ * The time between drains bounds how long the frame waited in the serial RX buffer.
+ * @param sequence Host sequence number.
+ * @param drainGap Time since the previous drain (us).
+ */
+void Bluetooth::replyPing(unsigned long sequence, unsigned long drainGap)
+{
+    Serial.print(F("{\"N\":110,\"D1\":"));
+    Serial.print(sequence);
+    Serial.print(F(",\"R\":"));
+    Serial.print(m_frameTime);
+    Serial.print(F(",\"L\":"));
+    Serial.print(drainGap);
+    Serial.print(F(",\"P\":"));
+    Serial.print(Clock::micros());
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the frame counters and the link-quality statistics.
+ */
+void Bluetooth::replyStats() const
+{
+    Serial.print(F("{\"N\":111,\"F\":"));
+    Serial.print(m_receivedFrames);
+    Serial.print(F(",\"C\":"));
+    Serial.print(m_coalescedFrames);
+    Serial.print(F(",\"D\":"));
+    Serial.print(m_droppedFrames);
+    Serial.print(F(",\"M\":"));
+    Serial.print(m_malformedFrames);
+    Serial.print(F(",\"O\":"));
+    Serial.print(m_linkStats.rxOverflows);
+    Serial.print(F(",\"G\":"));
+    Serial.print(m_linkStats.gapAverage);
+    Serial.print(F(",\"Gx\":"));
+    Serial.print(m_linkStats.gapMax);
+    Serial.print(F(",\"T\":"));
+    Serial.print(m_linkStats.rttAverage);
+    Serial.print(F(",\"Tx\":"));
+    Serial.print(m_linkStats.rttMax);
+    Serial.print(F(",\"Lx\":"));
+    Serial.print(m_linkStats.drainMax);
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the control tick statistics: {"N":112,"K":ticks,"J":jitter,"Jx":jitterMax,"Dx":durationMax,"O":overruns}, times in us.
+ */
+void Bluetooth::replyTickStats() const
+{
+    TickStats stats;
+    ControlTick::getStats(stats);
+    Serial.print(F("{\"N\":112,\"K\":"));
+    Serial.print(stats.ticks);
+    Serial.print(F(",\"J\":"));
+    Serial.print(stats.jitterAverage);
+    Serial.print(F(",\"Jx\":"));
+    Serial.print(stats.jitterMax);
+    Serial.print(F(",\"Dx\":"));
+    Serial.print(stats.durationMax);
+    Serial.print(F(",\"O\":"));
+    Serial.print(stats.overruns);
+    Serial.println('}');
+}
+
+/**
+ * @brief Send a parameter value, or only the result for commands without parameter.
+ * @param index Param index, Param::count for commands without parameter.
+ * @param valid Command result.
+ */
+void Bluetooth::replyParameter(unsigned char index, bool valid) const
+{
+    Serial.print(F("{\"N\":120,\"D1\":"));
+    Serial.print(index);
+    if (index < static_cast<unsigned char>(Param::count))
     {
-        m_data += static_cast<char>(Serial.read());
-        delay(3);
+        Serial.print(F(",\"D2\":"));
+        Serial.print(Parameters::get(static_cast<Param>(index)));
     }
-    if ((m_data.length() > 0) && m_data.endsWith("}"))
+    Serial.print(F(",\"OK\":"));
+    Serial.print(valid ? 1 : 0);
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the route table: {"N":180,"K":length,"R":"turns","OK":valid}.
+ * @param valid Last route change accepted.
+ */
+void Bluetooth::replyRoute(bool valid) const
+{
+    Serial.print(F("{\"N\":180,\"K\":"));
+    Serial.print(Routes::getLength());
+    Serial.print(F(",\"R\":\""));
+    for (unsigned char i{0}; i < Routes::getLength(); ++i)
+        Serial.print(static_cast<char>(Routes::get(i)));
+    Serial.print(F("\",\"OK\":"));
+    Serial.print(valid ? 1 : 0);
+    Serial.println('}');
+}
+
+/**
+ * @brief Update a rolling average and a maximum with a new value.
+ * @param average Rolling average.
+ * @param maximum Maximum.
+ * @param value New value, saturated to 65535.
+ */
+void Bluetooth::updateStats(unsigned short &average, unsigned short &maximum, unsigned long value)
+{
+    unsigned short sample = (value > 65535UL) ? 65535U : static_cast<unsigned short>(value);
+    if (sample > maximum)
+        maximum = sample;
+    average = static_cast<unsigned short>(average + ((static_cast<long>(sample) - average) >> s_statsShift));
+}
+
+/**
+ * @brief Change the robot mode from a received frame. The new mode is latched for the current drain,
+ * and supersedes the order deferred to the next one.
+ * @param mode RobotMode.
+ */
+void Bluetooth::changeMode(RobotMode mode)
+{
+    if (mode == m_mode)
         return;
-    else
-        m_data = "";
+    if (m_deferredOrder)
+    {
+        ++m_coalescedFrames;
+        m_deferredOrder = false;
+    }
+    m_mode = mode;
+    m_modeChanged = true;
+}
+
+/**
+ * @brief Set the remote order, which returns to the remote control mode, coalescing the orders
+ * received in the same drain to the latest one. STOP and mode changes jump the queue: STOP supersedes
+ * any pending order, and the orders received after it or after a mode change in the same drain are
+ * applied in the next one, so the new mode runs for at least one loop.
+ * @param order Order.
+ * @param speed Requested speed.
+ */
+void Bluetooth::setOrder(Order order, unsigned short speed, signed char linear, signed char angular)
+{
+    bool latched = m_modeChanged && (m_mode != RobotMode::REMOTECONTROL);
+    if ((order == Order::STOP) && !latched)
+    {
+        if (m_newOrder || m_deferredOrder)
+            ++m_coalescedFrames;
+        m_deferredOrder = false;
+        m_stopReceived = true;
+    }
+    else if (m_stopReceived || latched)
+    {
+        if (m_deferredOrder)
+            ++m_coalescedFrames;
+        m_nextOrder = order;
+        m_nextSpeed = speed;
+        m_nextLinear = linear;
+        m_nextAngular = angular;
+        m_deferredOrder = true;
+        return;
+    }
+    else if (m_newOrder)
+        ++m_coalescedFrames;
+    m_mode = RobotMode::REMOTECONTROL;
+    m_order = order;
+    m_speed = speed;
+    m_linear = linear;
+    m_angular = angular;
+    m_newOrder = true;
+}
+
+/**
+ * @brief Receive bluetooth data from Serial, draining and decoding every complete frame available.
+ * Incomplete frames are kept until the next call. Mode changes are applied in order as they are decoded.
+ */
+void Bluetooth::receiveData()
+{
+    m_newOrder = false;
+    m_stopReceived = false;
+    m_modeChanged = false;
+    if (m_deferredOrder) // Order received after a STOP or a mode change in the previous drain
+    {
+        m_deferredOrder = false;
+        setOrder(m_nextOrder, m_nextSpeed, m_nextLinear, m_nextAngular);
+    }
+
+    unsigned long drainTime = Clock::micros();
+    unsigned long drainGap = (drainTime - m_lastDrainTime) / 1000;
+    if ((m_lastDrainTime != 0) && (drainGap > m_linkStats.drainMax))
+        m_linkStats.drainMax = (drainGap > 65535UL) ? 65535U : static_cast<unsigned short>(drainGap);
+
+    if (Serial.available() >= (SERIAL_RX_BUFFER_SIZE - 1)) // RX buffer full, incoming bytes have been lost
+        ++m_linkStats.rxOverflows;
+
+    while (Serial.available() > 0)
+    {
+        char c = static_cast<char>(Serial.read());
+        if (m_vectorLength > 0) // Inside a binary frame, any byte value
+        {
+            m_vectorFrame[m_vectorLength++] = static_cast<unsigned char>(c);
+            if (m_vectorLength == s_vectorSize)
+            {
+                m_frameTime = Clock::micros();
+                decodeVector();
+                m_vectorLength = 0;
+            }
+            continue;
+        }
+        if (static_cast<unsigned char>(c) == s_vectorHeader) // Never inside a JSON frame, which is ASCII
+        {
+            if (m_frameLength > 0) // Previous frame never finished
+                ++m_malformedFrames;
+            m_frameLength = 0;
+            m_vectorFrame[m_vectorLength++] = s_vectorHeader;
+            continue;
+        }
+        if (c == '{')
+        {
+            if (m_frameLength > 0) // Previous frame never finished
+                ++m_malformedFrames;
+            m_frameLength = 0;
+        }
+        else if (m_frameLength == 0) // Not inside a frame
+            continue;
+
+        if (m_frameLength == s_frameSize) // Frame too long
+        {
+            ++m_droppedFrames;
+            m_frameLength = 0;
+            continue;
+        }
+        m_frame[m_frameLength++] = c;
+
+        if (c == '}')
+        {
+            m_frameTime = Clock::micros();
+            decodeElegooJSON();
+            m_frameLength = 0;
+        }
+    }
+    m_lastDrainTime = drainTime;
 }
\ No newline at end of file
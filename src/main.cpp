@@ -8,12 +8,16 @@
  */
 
 #include "bluetooth.h"
+#include "clock.h"
 #include "constants.h"
+#include "flightrecorder.h"
+#include "parameters.h"
 #include "robot.h"
 
 static Robot g_robot = Robot();                     // Initialization of the Robot object
 static Bluetooth g_bluetooth = Bluetooth();         // Initialization of the bluetooth object
 static RobotMode g_mode = RobotMode::REMOTECONTROL; // Default robot mode
+static unsigned char g_parametersRevision = 0;      // Parameters applied to the robot
 
 /**
  * @brief Main setup. Initialize robot.
@@ -21,7 +25,7 @@ static RobotMode g_mode = RobotMode::REMOTECONTROL; // Default robot mode
 void setup()
 {
     g_robot.begin();
-    delay(Constants::serialDelay); // To make Serial work
+    Clock::delay(Constants::serialDelay); // To make Serial work
 }
 
 /**
@@ -29,17 +33,38 @@ void setup()
  */
 void loop()
 {
-    g_bluetooth.receiveData();
-    if (g_bluetooth.getData() != "")
-        g_bluetooth.decodeElegooJSON();
+    g_bluetooth.receiveData(); // Drain and decode every complete frame
+    if (g_parametersRevision != Parameters::getRevision())
+    {
+        g_parametersRevision = Parameters::getRevision();
+        g_robot.applyParameters();
+    }
+    bool clearMap;
+    if (g_bluetooth.takeMapRequest(clearMap))
+        g_robot.replyMap(clearMap);
+    bool resetLaps;
+    if (g_bluetooth.takeLapRequest(resetLaps))
+        g_robot.replyLaps(resetLaps);
+    if (g_bluetooth.takeBatteryRequest())
+        g_robot.replyBattery();
+    FlightRecorder::stream();
+    if ((g_robot.getBatteryLevel() == BatteryLevel::CRITICAL) && (g_bluetooth.getMode() != RobotMode::REMOTECONTROL) && (g_bluetooth.getMode() != RobotMode::IRCONTROL))
+        g_bluetooth.setMode(RobotMode::REMOTECONTROL); // Only driven by hand until recharged
     if (g_mode != g_bluetooth.getMode())
+    {
+        FlightRecorder::log(FlightEvent::MODE, static_cast<unsigned char>(g_bluetooth.getMode()));
         g_robot.restartState();
+    }
+    g_robot.acquireSensors(); // Read once, shared by the mode
 
     switch (g_bluetooth.getMode())
     {
     case RobotMode::REMOTECONTROL:
         g_mode = RobotMode::REMOTECONTROL;
-        g_robot.remoteControlMode(g_bluetooth.getOrder(), g_bluetooth.getSpeed(), g_bluetooth.getSpeed());
+        if (g_bluetooth.getOrder() == Order::VECTOR)
+            g_robot.remoteVectorMode(g_bluetooth.getLinear(), g_bluetooth.getAngular());
+        else
+            g_robot.remoteControlMode(g_bluetooth.getOrder(), g_bluetooth.getSpeed(), g_bluetooth.getSpeed());
         break;
 
     case RobotMode::IRCONTROL:
@@ -67,6 +92,13 @@ void loop()
         g_robot.customMode();
         break;
 
+    case RobotMode::CALIBRATION:
+        g_robot.calibrationMode();
+        g_bluetooth.setMode(RobotMode::REMOTECONTROL); // Only once
+        g_mode = RobotMode::REMOTECONTROL;
+        g_robot.restartState();
+        break;
+
     default:
         break;
     }
@@ -0,0 +1,185 @@
+/**
+ * @file parameters.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Runtime tuning parameters stored in EEPROM, with the constants as defaults.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "constants.h"
+#include "motors.h"
+#include "parameters.h"
+#include "routes.h"
+
+static_assert(Parameters::s_address + 4 + 2 * Parameters::s_count <= Routes::s_address, "The parameters overlap the route table in EEPROM");
+
+/**
+ * @brief Defaults and ranges, in the same order as Param.
+ */
+const ParamInfo Parameters::s_info[Parameters::s_count] PROGMEM{
+    {Constants::crankSpeed, 1, 255}, // Not below idleSpeed
+    {Constants::idleSpeed, 1, 255},
+    {Constants::linearSpeed, 1, 255}, // Divisor of the junction times
+    {Constants::rotateSpeed, 1, 255}, // Divisor of the odometry turn scale
+    {Constants::rotate90Time, 50, 5000},
+    {Constants::rotate180Time, 100, 10000},
+    {Constants::updateInterval, 20, 2000},
+    {Constants::minDistance, 5, Constants::maxDistance},
+    {Constants::minDetourDistance, 3, Constants::maxDistanceLineTracking},
+    {Constants::updateUltrasonicInterval, 10, 1000},
+    {Constants::extraTimeLine, 0, 1000},
+    {Constants::timeUntilLost, 0, 5000},
+    {Constants::lineGapTime, 0, 5000},
+    {Constants::lineSearchDistance, 0, 2000},
+    {Constants::lineSearchSpeed, 1, 255},
+    {Constants::marginObject, 0, 20},
+    {Constants::detourKp, 0, 100},
+    {Constants::detourKd, 0, 200},
+    {Constants::cornerDistance, 1, Constants::maxDistanceLineTracking},
+    {Constants::cornerRatio, 0, 100},
+    {Constants::timeMoving, 0, 5000},
+    {Constants::timeMoveAway, 0, 5000},
+    {Constants::servo0, 400, 1000},
+    {Constants::servo180, 2000, 2600},
+    {Constants::IRMovingInterval, 20, 2000},
+    {Constants::idleTimeout, 1000, 60000},
+    {Constants::pwmFrequency, 0, static_cast<unsigned short>(PwmFrequency::COUNT) - 1},
+    {Constants::steerDistance, 0, Constants::maxDistance},
+    {Constants::criticalTime, 0, 5000},
+    {Constants::stopMargin, 0, Constants::maxDistance},
+};
+
+unsigned short Parameters::s_values[Parameters::s_count]; // From s_info or EEPROM, set by load()
+
+unsigned char Parameters::s_revision{0};
+
+/**
+ * @brief Update a CRC-16 with a block of data.
+ * @param crc Initial CRC.
+ * @param data Data.
+ * @param length Data length in bytes.
+ * @return unsigned short Updated CRC.
+ */
+unsigned short Parameters::crc(unsigned short crc, const unsigned char *data, size_t length)
+{
+    for (size_t i{0}; i < length; ++i)
+        crc = _crc16_update(crc, data[i]);
+    return crc;
+}
+
+/**
+ * @brief Return the revision of the parameters, increased on every change.
+ * @return unsigned char Revision.
+ */
+unsigned char Parameters::getRevision()
+{
+    return s_revision;
+}
+
+/**
+ * @brief Return the default value and range of a parameter.
+ * @param param Parameter.
+ * @return ParamInfo Parameter description.
+ */
+ParamInfo Parameters::getInfo(Param param)
+{
+    ParamInfo info;
+    memcpy_P(&info, &s_info[static_cast<unsigned char>(param)], sizeof(ParamInfo));
+    return info;
+}
+
+/**
+ * @brief Set a parameter in RAM. Use save() to keep it after a reset.
+ * @param param Parameter.
+ * @param value New value.
+ * @return true Value set.
+ * @return false Unknown parameter, value out of range or idle speed above the crank speed.
+ */
+bool Parameters::set(Param param, unsigned short value)
+{
+    if (static_cast<unsigned char>(param) >= s_count)
+        return false;
+    ParamInfo info = getInfo(param);
+    if ((value < info.minValue) || (value > info.maxValue))
+        return false;
+    if (((param == Param::idleSpeed) && (value > get(Param::crankSpeed))) || ((param == Param::crankSpeed) && (value < get(Param::idleSpeed))))
+        return false; // Inverted dead band
+    s_values[static_cast<unsigned char>(param)] = value;
+    ++s_revision;
+    return true;
+}
+
+/**
+ * @brief Load the parameters from EEPROM. The defaults are used if the stored
+ * version, number of parameters, CRC or any range is not valid, or the idle speed is above the crank speed.
+ * @return true Parameters loaded from EEPROM.
+ * @return false Defaults used.
+ */
+bool Parameters::load()
+{
+    unsigned char version = EEPROM.read(s_address);
+    unsigned char count = EEPROM.read(s_address + 1);
+    unsigned short storedCrc;
+    EEPROM.get(s_address + 2, storedCrc);
+    if ((version != s_version) || (count != s_count))
+    {
+        reset();
+        return false;
+    }
+
+    unsigned short values[s_count];
+    EEPROM.get(s_address + 4, values);
+    const unsigned char header[2]{version, count};
+    unsigned short valuesCrc = crc(0xFFFF, header, sizeof(header));
+    valuesCrc = crc(valuesCrc, reinterpret_cast<const unsigned char *>(values), sizeof(values));
+    if (valuesCrc != storedCrc)
+    {
+        reset();
+        return false;
+    }
+    for (unsigned char i{0}; i < s_count; ++i)
+    {
+        ParamInfo info = getInfo(static_cast<Param>(i));
+        if ((values[i] < info.minValue) || (values[i] > info.maxValue))
+        {
+            reset();
+            return false;
+        }
+    }
+    if (values[static_cast<unsigned char>(Param::idleSpeed)] > values[static_cast<unsigned char>(Param::crankSpeed)])
+    {
+        reset();
+        return false;
+    }
+    memcpy(s_values, values, sizeof(s_values));
+    ++s_revision;
+    return true;
+}
+
+/**
+ * @brief Save the parameters in EEPROM, only writing the bytes which changed.
+ */
+void Parameters::save()
+{
+    const unsigned char header[2]{s_version, s_count};
+    unsigned short valuesCrc = crc(0xFFFF, header, sizeof(header));
+    valuesCrc = crc(valuesCrc, reinterpret_cast<const unsigned char *>(s_values), sizeof(s_values));
+    EEPROM.update(s_address, header[0]);
+    EEPROM.update(s_address + 1, header[1]);
+    EEPROM.put(s_address + 2, valuesCrc);
+    EEPROM.put(s_address + 4, s_values);
+}
+
+/**
+ * @brief Restore the default values in RAM.
+ */
+void Parameters::reset()
+{
+    for (unsigned char i{0}; i < s_count; ++i)
+        s_values[i] = getInfo(static_cast<Param>(i)).defaultValue;
+    ++s_revision;
+}
\ No newline at end of file
@@ -8,13 +8,19 @@
  */
 
 #include <Arduino.h>
+#include <util/atomic.h>
+#include "clock.h"
 #include "constants.h"
+#include "flightrecorder.h"
 #include "infrared.h"
 #include "linetracking.h"
+#include "lowpower.h"
 #include "motors.h"
 #include "myservo.h"
+#include "parameters.h"
 #include "robot.h"
 #include "ultrasonic.h"
+#include "ultrasonicarray.h"
 
 /**
  * @brief Construct a new Robot::Robot object.
@@ -24,10 +30,19 @@ Robot::Robot()
       m_servo{Pins::servoPin, Constants::servo0, Constants::servo180},
       m_ultrasonic{Pins::triggerPin, Pins::echoPin},
       m_lineTracking{Pins::ltLeftPin, Pins::ltMidPin, Pins::ltRightPin},
+      m_battery{Pins::batteryPin, Constants::batteryCountVoltage, Constants::batteryInterval}, m_batteryLevel{BatteryLevel::NONE},
+      m_snapshot{0, 0, Constants::maxDistance, 90, 0, false, 90, 0, 0, {Constants::maxDistance, Constants::maxDistance}, {0, 0}, 0, 0},
+      m_lastPing{0}, m_pingInterval{0}, m_pingMaxDistance{Constants::maxDistance},
       m_sonarMap{Constants::maxDistance, Constants::maxDistance, Constants::maxDistance, Constants::maxDistance, Constants::maxDistance},
-      m_state{RobotModeState::START}, m_previousAngle{90}, m_interval{Constants::updateInterval}, m_infrared{Pins::IRPin}
+      m_escapes{Constants::escapeMemoryTime},
+      m_governor{static_cast<float>(Constants::fullSpeed) / 255, Constants::brakeDeceleration, Constants::governorReaction, Constants::speedRamp}, m_scans{0},
+      m_state{RobotModeState::START}, m_previousAngle{90}, m_interval{Constants::updateInterval}, m_lastSteer{0},
+      m_detourError{0}, m_detourCorner{false}, m_lineFollower{LineCommandType::STOP, 0, 0, 0, 0, 0, 0, 0}, m_lineLostTicks{0}, m_lineBias{0}, m_lineLeft{false},
+      m_junctionPhase{JunctionPhase::NONE}, m_junctionWays{0}, m_junctionTicks{0}, m_junctionLeft{false}, m_branchTicks{0, 0}, m_lineMarker{false}, m_ticks{0}, m_junctions{0},
+      m_lineCorrections{0}, m_lap{0, 0, 0, 0, 0, 0}, m_recentLaps{}, m_bestLap{0}, m_laps{0}, m_lapRunning{false}, m_lapStart{0}, m_lapClock{0}, m_searchLeft{false},
+      m_searchPhase{SearchPhase::SWEEP}, m_searchDistance{0}, m_idle{false}, m_infrared{Pins::IRPin}
 {
-    m_lastUpdate = millis();
+    m_lastUpdate = Clock::millis();
 }
 
 /**
@@ -40,18 +55,37 @@ Robot::~Robot()
 
 void Robot::restartState()
 {
+    followLine(LineCommandType::RESET); // Before any motor command
+    LineEvent event;
+    while (m_lineEvents.pop(event))
+        ; // Discard the pending reports
+    unsigned long tick;
+    while (m_lapMarkers.pop(tick))
+        ; // Crossings of the previous run
+    m_infrared.clear(); // Keys pressed in the previous mode
+    if (m_idle)
+        wakeUp();
     if (m_servo.read() != 90)
         m_servo.write(90);
-    m_lastUpdate = millis();
+    m_lastUpdate = Clock::millis();
     if (!m_motors.isStopped())
         m_motors.stop();
-    m_state = RobotModeState::START;
+    setState(RobotModeState::START);
     m_previousAngle = 90;
-    m_interval = Constants::updateInterval;
+    m_interval = Parameters::get(Param::updateInterval);
+    setSonar(0, Constants::maxDistance); // Each mode sets its pings
+    m_lastPing = Clock::millis();
+    m_detourError = 0;
+    m_detourCorner = false;
+    m_lapRunning = false; // Timed from the next marker, the completed laps are kept
     for (size_t i{0}; i < 5; ++i)
     {
-        m_sonarMap[i] = Constants::maxDistance; // Default values
+        resetSonarMap(i); // Default values
     }
+    m_odometry.reset(Clock::millis()); // The obstacle grid is kept for the next runs from the same start
+    m_escapes.clear();                 // Headings from the previous start
+    m_governor.reset();
+    m_scans = 0;
 }
 
 /**
@@ -60,10 +94,133 @@ void Robot::restartState()
 void Robot::begin()
 {
     Serial.begin(Constants::serialBaud); // Can not be inside a constructor
+    FlightRecorder::begin();             // Keep the records from before the reset
+    FlightRecorder::dump();
+    Parameters::load();                  // Stored tuning, defaults if not valid
+    Routes::load();                      // Stored route, none if not valid
+    applyParameters();
+    m_battery.begin();
+    compensateBattery();
     m_servo.begin();                     // Servo initialization can not be done inside Robot constructor
+    if (Constants::sideSonars)           // Looking to opposite sides, pinged together
+    {
+        UltrasonicArray::add(Pins::rightTriggerPin, Pins::rightEchoPin, 0);
+        UltrasonicArray::add(Pins::leftTriggerPin, Pins::leftEchoPin, 0);
+        UltrasonicArray::begin(Constants::maxDistance, Constants::sonarQuietTime);
+    }
+    ControlTick::begin(Constants::controlTickPeriod, controlTick, this); // Timer1 started by the servo
     m_infrared.begin();                  // Infrared initialization
 }
 
+/**
+ * @brief Read the sensors once for this loop, pinging at the interval set by the mode.
+ */
+void Robot::acquireSensors()
+{
+    m_snapshot.time = Clock::millis();
+    m_snapshot.lines = m_lineTracking.read();
+    m_snapshot.servoAngle = m_servo.read();
+    m_motors.getSpeeds(m_snapshot.leftSpeed, m_snapshot.rightSpeed); // Atomic, the control tick may drive the motors
+    m_snapshot.sonarNew = false;
+    m_snapshot.sidesNew = 0;
+    if (m_battery.update(m_snapshot.time))
+        compensateBattery();
+    if (Constants::sideSonars)
+    {
+        UltrasonicArray::update();
+        for (unsigned char i{0}; i < 2; ++i)
+        {
+            if (UltrasonicArray::isNew(i))
+            {
+                m_snapshot.sideDistances[i] = UltrasonicArray::getDistance(i);
+                m_snapshot.sideTimes[i] = UltrasonicArray::getTime(i);
+                m_snapshot.sidesNew |= _BV(i);
+            }
+        }
+    }
+    if ((m_pingInterval > 0) && ((m_snapshot.time - m_lastPing) >= m_pingInterval))
+    {
+        m_snapshot.sonarAngle = m_snapshot.servoAngle;
+        m_snapshot.distance = ping(m_pingMaxDistance);
+        m_snapshot.sonarTime = m_lastPing;
+        m_snapshot.sonarNew = true;
+    }
+}
+
+/**
+ * @brief Use the given readings for this loop instead of acquireSensors(), to replay recorded or
+ * synthetic sensors. The ping interval set by the mode is then up to the caller.
+ * @param snapshot Readings.
+ */
+void Robot::setSnapshot(const SensorSnapshot &snapshot)
+{
+    m_snapshot = snapshot;
+    if (m_snapshot.sonarNew)
+        m_lastPing = m_snapshot.sonarTime;
+}
+
+/**
+ * @brief Scale the motors PWM by the nominal / battery voltage, so that the speeds and the times to
+ * rotate measured at full battery stay valid while it discharges.
+ */
+void Robot::compensateBattery()
+{
+    m_snapshot.voltage = m_battery.getVoltage();
+    BatteryLevel level = m_battery.getLevel(Constants::batteryWeak, Constants::batteryCritical);
+    unsigned long scale{256};
+    if (level != BatteryLevel::NONE) // Not compensated on USB power
+    {
+        scale = static_cast<unsigned long>(Constants::batteryNominal) * 256 / m_snapshot.voltage;
+        if (scale > Constants::maxVoltageScale)
+            scale = Constants::maxVoltageScale;
+    }
+    m_motors.setVoltageScale(scale);
+    if (level != m_batteryLevel)
+    {
+        m_batteryLevel = level;
+        FlightRecorder::log(FlightEvent::BATTERY, static_cast<unsigned char>(level), m_snapshot.voltage);
+    }
+}
+
+/**
+ * @brief Get the battery charge level.
+ * @return BatteryLevel Level.
+ */
+BatteryLevel Robot::getBatteryLevel() const
+{
+    return m_batteryLevel;
+}
+
+/**
+ * @brief Get the sensor readings of this loop.
+ * @return const SensorSnapshot& Snapshot.
+ */
+const SensorSnapshot &Robot::getSnapshot() const
+{
+    return m_snapshot;
+}
+
+/**
+ * @brief Get the stops to scan around in obstacle avoidance since the mode start.
+ * @return unsigned short Stops.
+ */
+unsigned short Robot::getScans() const
+{
+    return m_scans;
+}
+
+/**
+ * @brief Apply the parameters cached by the hardware libraries. Call it after changing the parameters.
+ */
+void Robot::applyParameters()
+{
+    m_motors.setMinSpeeds(Parameters::get(Param::crankSpeed), Parameters::get(Param::idleSpeed));
+    m_motors.setPwmFrequency(static_cast<PwmFrequency>(Parameters::get(Param::pwmFrequency)));
+    m_servo.setEndpoints(Parameters::get(Param::servo0), Parameters::get(Param::servo180));
+    // Pivoting at rotateSpeed turns 90 deg in rotate90Time
+    m_odometry.setScales(static_cast<float>(Constants::fullSpeed) / 255, HALF_PI * 1000 / Parameters::get(Param::rotate90Time) / Parameters::get(Param::rotateSpeed));
+}
+
 /**
  * @brief Move the robot based on a remote order received by Bluetooth.
  * @param order Order.
@@ -72,6 +229,13 @@ void Robot::begin()
  */
 void Robot::remoteControlMode(Order order, unsigned char linearSpeed, unsigned char rotateSpeed)
 {
+    if (order != Order::STOP)
+    {
+        if (m_idle)
+            wakeUp();
+        m_lastUpdate = Clock::millis();
+    }
+
     switch (order)
     {
     case Order::LEFT:
@@ -88,6 +252,7 @@ void Robot::remoteControlMode(Order order, unsigned char linearSpeed, unsigned c
         return;
     case Order::STOP:
         m_motors.stop();
+        idleControl();
         return;
     case Order::FORWARD_LEFT:
         m_motors.forwardLeft(linearSpeed);
@@ -106,6 +271,47 @@ void Robot::remoteControlMode(Order order, unsigned char linearSpeed, unsigned c
     }
 }
 
+/**
+ * @brief Move the robot with the linear and angular velocities received by Bluetooth.
+ * @param linear Linear velocity, -127..127 backward..forward.
+ * @param angular Angular velocity, -127..127 right..left.
+ */
+void Robot::remoteVectorMode(signed char linear, signed char angular)
+{
+    if (m_idle)
+        wakeUp();
+    m_lastUpdate = Clock::millis();
+    m_motors.moveVector(linear * 255 / 127, angular * 255 / 127);
+}
+
+/**
+ * @brief After idleTimeout stopped, detach the servo, turn the motors and the IR receiver off,
+ * and sleep until a new byte is received or the IR pin changes.
+ */
+void Robot::idleControl()
+{
+    if (!m_idle && ((Clock::millis() - m_lastUpdate) >= Parameters::get(Param::idleTimeout)))
+    {
+        m_servo.detach(); // Stop holding 90 deg
+        m_motors.off();
+        m_infrared.end(); // Keys ignored while sleeping, the IR pin only wakes up
+        m_idle = true;
+    }
+    if (m_idle)
+        LowPower::idle(Pins::IRPin);
+}
+
+/**
+ * @brief Leave the idle state, attaching the servo and starting the IR receiver again.
+ */
+void Robot::wakeUp()
+{
+    m_servo.begin();
+    m_infrared.begin();
+    m_idle = false;
+    m_lastUpdate = Clock::millis();
+}
+
 /**
  * @brief Move the robot based on a remote order received by IR.
  * @param linearSpeed
@@ -113,36 +319,35 @@ void Robot::remoteControlMode(Order order, unsigned char linearSpeed, unsigned c
  */
 void Robot::IRControlMode(unsigned char linearSpeed, unsigned char rotateSpeed)
 {
-    Key key = m_infrared.decodeIR();
-    switch (key)
+    IREvent event;
+    while (m_infrared.read(event)) // Keys received since the last loop, oldest first
     {
-    case Key::keyOk:
-        m_motors.stop();
-        m_lastUpdate = millis();
-        break;
-    case Key::keyUp:
-        m_motors.forward(linearSpeed);
-        m_lastUpdate = millis();
-        break;
-    case Key::keyDown:
-        m_motors.backward(linearSpeed);
-        m_lastUpdate = millis();
-        break;
-    case Key::keyLeft:
-        m_motors.left(rotateSpeed);
-        m_lastUpdate = millis();
-        break;
-    case Key::keyRight:
-        m_motors.right(rotateSpeed);
-        m_lastUpdate = millis();
-        break;
-    default:
-        break;
+        switch (event.key)
+        {
+        case Key::keyOk:
+            m_motors.stop();
+            break;
+        case Key::keyUp:
+            m_motors.forward(linearSpeed);
+            break;
+        case Key::keyDown:
+            m_motors.backward(linearSpeed);
+            break;
+        case Key::keyLeft:
+            m_motors.left(rotateSpeed);
+            break;
+        case Key::keyRight:
+            m_motors.right(rotateSpeed);
+            break;
+        default:
+            continue;
+        }
+        m_lastUpdate = event.time; // Received after the snapshot if newer
     }
 
-    if ((millis() - m_lastUpdate) >= Constants::IRMovingInterval) // Stop after IRMovingInterval
+    if (static_cast<long>(m_snapshot.time - m_lastUpdate) >= static_cast<long>(Parameters::get(Param::IRMovingInterval))) // Stop after IRMovingInterval
     {
-        m_lastUpdate = millis();
+        m_lastUpdate = m_snapshot.time;
         m_motors.stop();
     }
 }
@@ -152,88 +357,118 @@ void Robot::IRControlMode(unsigned char linearSpeed, unsigned char rotateSpeed)
  */
 void Robot::obstacleAvoidanceMode()
 {
-    if ((millis() - m_lastUpdate) >= m_interval)
+    m_odometry.update(m_snapshot.time, m_snapshot.leftSpeed, m_snapshot.rightSpeed);
+    bool updateTime = m_snapshot.sonarNew; // Pinged every m_interval, once the servo has reached the position
+    if (updateTime)
+    {
+        unsigned char index = mapAngle(m_snapshot.sonarAngle);
+        mapReading(m_snapshot.sonarAngle, m_snapshot.distance);
+        m_rangeEstimators[index].update(m_snapshot.distance, m_snapshot.sonarTime, commandedRate(index), Constants::maxDistance);
+    }
+    for (unsigned char i{0}; i < 2; ++i) // Fixed side sonars, as the servo at 0 and 180 deg
+    {
+        if (m_snapshot.sidesNew & _BV(i))
+        {
+            unsigned char index = mapAngle(i * 180);
+            mapReading(i * 180, m_snapshot.sideDistances[i]);
+            m_rangeEstimators[index].update(m_snapshot.sideDistances[i], m_snapshot.sideTimes[i], commandedRate(index), Constants::maxDistance);
+        }
+    }
+
+    if (m_state == RobotModeState::FORWARD) // Steer while moving, between pings too
+    {
+        if ((m_snapshot.time - m_lastSteer) >= Constants::steerInterval)
+        {
+            m_lastSteer = m_snapshot.time;
+            updateSonarMap(); // Current estimates of all directions
+            if (!steerControl()) // Collision too close, stop and scan
+            {
+                ++m_scans;
+                m_servo.write(180); // Full scan from wherever the sweep is: 180, 90, 0
+                m_previousAngle = 90;
+                m_motors.stop();
+                setState(RobotModeState::OBSTACLE);
+                m_lastPing = m_snapshot.time; // Full interval for the servo to turn
+                setSonar(m_interval, Constants::maxDistance);
+                return;
+            }
+        }
+        if (updateTime)
+            moveServoSequence();
+        setSonar(m_interval, Constants::maxDistance);
+        return;
+    }
+
+    if (updateTime)
     {
-        m_lastUpdate = millis();
-        m_sonarMap[mapAngle(m_servo.read())] = m_ultrasonic.getDistance(Constants::maxDistance);
+        updateSonarMap(); // Current estimates of all directions
         switch (m_state)
         {
         case RobotModeState::START:
-            if (m_sonarMap[2] >= Constants::minDistance)
+        {
+            for (size_t i{0}; i < 5; ++i)
+            {
+                if (i != 2) // Just pinged, after the turn
+                    resetSonarMap(i); // The side sonars kept pinging while turning
+            }
+            unsigned char speed = (m_sonarMap[2] >= Parameters::get(Param::minDistance)) ? m_governor.limit(m_snapshot.time, m_sonarMap[2], frontApproach(), Parameters::get(Param::stopMargin), Parameters::get(Param::crankSpeed), 255) : 0;
+            if (speed)
             {
                 m_previousAngle = 30;
                 moveServoSequence();
-                m_motors.forward(calculateSpeed(m_sonarMap[2]));
-                m_state = RobotModeState::FORWARD;
-                m_interval = Constants::updateInterval; // Reset scan interval
+                m_motors.forward(speed);
+                setState(RobotModeState::FORWARD);
+                m_interval = Parameters::get(Param::updateInterval); // Reset scan interval
+                m_lastSteer = m_snapshot.time;
             }
             else
             {
+                ++m_scans;
                 m_previousAngle = 0;
                 moveServoSequence();
                 m_motors.stop();
-                m_state = RobotModeState::OBSTACLE;
-                m_interval = Constants::updateInterval; // Reset scan interval
-            }
-            break;
-        case RobotModeState::FORWARD:
-            if (m_sonarMap[2] < Constants::minDistance)
-            {
-                m_previousAngle = 0;
-                moveServoSequence(); // Go to 180
-                m_motors.stop();
-                m_state = RobotModeState::OBSTACLE;
-                m_interval = Constants::updateInterval; // Reset scan interval
-            }
-            else if (m_sonarMap[1] < Constants::minDistance)
-            {
-                if (!m_motors.isRotatingLeft())
-                    m_motors.left(Constants::rotateSpeed);
-                m_interval = 0; // Scan faster and don't turn the servo
-            }
-            else if (m_sonarMap[3] < Constants::minDistance)
-            {
-                if (!m_motors.isRotatingRight())
-                    m_motors.right(Constants::rotateSpeed);
-                m_interval = 0; // Scan faster and don't turn the servo
-            }
-            else
-            {
-                moveServoSequence();
-                m_motors.forward(calculateSpeed(m_sonarMap[2]));
-                m_interval = Constants::updateInterval; // Reset scan interval
+                setState(RobotModeState::OBSTACLE);
+                m_interval = Parameters::get(Param::updateInterval); // Reset scan interval
             }
             break;
+        }
         case RobotModeState::OBSTACLE:
-            if (m_servo.read() != 0)
+            if (m_snapshot.sonarAngle != 0)
                 moveServoSequence();
             else
             {
                 moveServoSequence(); // Go back to 90
-                if ((m_sonarMap[0] < Constants::minDistance) && (m_sonarMap[2] < Constants::minDistance) && (m_sonarMap[4] < Constants::minDistance))
-                    m_state = RobotModeState::BLOCKED;
+                if ((m_sonarMap[0] < Parameters::get(Param::minDistance)) && (m_sonarMap[2] < Parameters::get(Param::minDistance)) && (m_sonarMap[4] < Parameters::get(Param::minDistance)))
+                    setState(RobotModeState::BLOCKED);
                 else
-                    m_state = RobotModeState::ROTATE;
+                    setState(RobotModeState::ROTATE);
             }
             break;
-        case RobotModeState::ROTATE:
-            (m_sonarMap[0] < m_sonarMap[4]) ? m_motors.left(Constants::rotateSpeed) : m_motors.right(Constants::rotateSpeed); // Condicional operator
-            m_interval = Constants::rotate90Time;                                                                             // Rotate 90
-            m_state = RobotModeState::START;
-            m_sonarMap[1] = Constants::maxDistance; // Reset values
-            m_sonarMap[3] = Constants::maxDistance; // Reset values
+        case RobotModeState::ROTATE: // Freer side, away from the recent dead ends
+            m_escapes.chooseLeft(m_snapshot.time, m_odometry.getHeading(), m_sonarMap[0], m_sonarMap[4], false) ? m_motors.left(Parameters::get(Param::rotateSpeed)) : m_motors.right(Parameters::get(Param::rotateSpeed));
+            m_interval = Parameters::get(Param::rotate90Time);                                                                             // Rotate 90
+            setState(RobotModeState::START);
+            for (size_t i{0}; i < 5; ++i)
+            {
+                resetSonarMap(i); // Every direction points elsewhere after the turn
+            }
+            m_governor.reset(); // Readings of the previous heading
             break;
         case RobotModeState::BLOCKED:
-            (m_sonarMap[0] < m_sonarMap[4]) ? m_motors.left(Constants::rotateSpeed) : m_motors.right(Constants::rotateSpeed); // Condicional operator
-            m_interval = Constants::rotate180Time;                                                                            // Rotate 180
-            m_state = RobotModeState::START;
-            m_sonarMap[1] = Constants::maxDistance; // Reset values
-            m_sonarMap[3] = Constants::maxDistance; // Reset values
+            m_escapes.chooseLeft(m_snapshot.time, m_odometry.getHeading(), m_sonarMap[0], m_sonarMap[4], true) ? m_motors.left(Parameters::get(Param::rotateSpeed)) : m_motors.right(Parameters::get(Param::rotateSpeed));
+            m_interval = Parameters::get(Param::rotate180Time);                                                                            // Rotate 180
+            setState(RobotModeState::START);
+            for (size_t i{0}; i < 5; ++i)
+            {
+                resetSonarMap(i); // Every direction points elsewhere after the turn
+            }
+            m_governor.reset(); // Readings of the previous heading
             break;
         default:
             break;
         }
     }
+    setSonar(m_interval, Constants::maxDistance);
 }
 
 /**
@@ -241,106 +476,149 @@ void Robot::obstacleAvoidanceMode()
  */
 void Robot::lineTrackingMode()
 {
+    updateLap();
     switch (m_state)
     {
     case RobotModeState::START:
-        if (m_lineTracking.allLines()) // Car not on the floor
+        if (m_snapshot.lines == LineTracking::s_all) // Car not on the floor
             break;
-        if ((millis() - m_lastUpdate) >= Constants::updateUltrasonicInterval)
+        if (m_snapshot.sonarNew)
         {
-            m_sonarMap[mapAngle(90)] = m_ultrasonic.getDistance(Constants::maxDistanceLineTracking);
-            m_lastUpdate = millis();
-            if ((m_sonarMap[mapAngle(90)] >= Constants::minDetourDistance) && m_lineTracking.anyLine())
-                m_state = RobotModeState::FORWARD; // Move only if no obstacle and any line detected
+            m_sonarMap[mapAngle(90)] = m_snapshot.distance;
+            m_rangeEstimators[2].update(m_snapshot.distance, m_snapshot.sonarTime, commandedRate(2), Constants::maxDistanceLineTracking);
+            if ((m_sonarMap[mapAngle(90)] >= Parameters::get(Param::minDetourDistance)) && m_snapshot.lines)
+            {
+                setState(RobotModeState::FORWARD); // Move only if no obstacle and any line detected
+                unsigned char crankSpeed = Parameters::get(Param::crankSpeed);
+                followLine(LineCommandType::START, max(m_governor.limit(m_snapshot.time, m_sonarMap[2], frontApproach(), Parameters::get(Param::stopMargin), crankSpeed, 255), crankSpeed));
+            }
         }
         break;
-    case RobotModeState::FORWARD:
-        // Update ultrasonic map
-        if ((millis() - m_lastUpdate) >= Constants::updateUltrasonicInterval)
+    case RobotModeState::FORWARD: // The control tick follows the line
+    {
+        LineEvent event;
+        if (m_lineEvents.pop(event)) // Line lost or route end, motors released by the control tick
         {
-            m_lastUpdate = millis();
-            m_sonarMap[2] = m_ultrasonic.getDistance(Constants::maxDistanceLineTracking);
-            if (m_sonarMap[2] < Constants::minDetourDistance) // Obstacle found
+            if (event.routeEnd) // Destination reached
             {
                 m_motors.stop();
-                m_servo.write(0); // Look right
-                m_state = RobotModeState::ROTATE;
-                m_motors.left(Constants::rotateSpeed);
-                m_lastUpdate = millis();
-                delay(Constants::rotate90Time / 2); // To avoid the line detection in ROTATE
-                return;
+                setState(RobotModeState::BLOCKED);
             }
+            else
+                startLineSearch(event);
+            break;
         }
-
-        if (m_lineTracking.leftLine())
-            m_motors.left(Constants::rotateSpeed);
-        else if (m_lineTracking.rightLine())
-            m_motors.right(Constants::rotateSpeed);
-        else if (m_lineTracking.midLine())
-            m_motors.forward(calculateSpeed(m_sonarMap[2], Constants::minDetourDistance, Constants::maxDistanceLineTracking, Constants::linearSpeed));
-        else // No line detected
+        // Update ultrasonic map
+        if (m_snapshot.sonarNew)
         {
-            // Wait to avoid line missing in between sensors
-            unsigned long timeNoLine = millis();
-            while ((millis() - timeNoLine) < Constants::timeUntilLost)
+            m_sonarMap[2] = m_snapshot.distance;
+            m_rangeEstimators[2].update(m_snapshot.distance, m_snapshot.sonarTime, commandedRate(2), Constants::maxDistanceLineTracking);
+            unsigned char speed = m_governor.limit(m_snapshot.time, m_sonarMap[2], frontApproach(), Parameters::get(Param::stopMargin), Parameters::get(Param::crankSpeed), 255);
+            if ((m_sonarMap[2] < Parameters::get(Param::minDetourDistance)) || (speed == 0)) // Obstacle found, or too close to stop before it
             {
-                if (m_lineTracking.anyLine())
-                    return;
+                followLine(LineCommandType::STOP); // Before any motor command
+                m_motors.stop();
+                m_servo.write(0); // Look right
+                resetSonarMap(2); // Readings of the previous heading
+                setState(RobotModeState::ROTATE);
+                m_motors.left(Parameters::get(Param::rotateSpeed));
+                m_lastUpdate = m_snapshot.time;
+                Clock::delay(Parameters::get(Param::rotate90Time) / 2); // To avoid the line detection in ROTATE
+                setSonar(0, Constants::maxDistanceLineTracking);
+                return;
             }
-            m_motors.stop();
-            m_state = RobotModeState::LINELOST;
+            followLine(LineCommandType::SPEED, speed);
         }
         break;
+    }
     case RobotModeState::OBSTACLE:
-        if (!m_lineTracking.midLine())
+        if (!(m_snapshot.lines & LineTracking::s_mid))
         {
-            if ((millis() - m_lastUpdate) >= Constants::updateUltrasonicInterval)
+            if (m_snapshot.sonarNew) // Fixed ping rate for the controller
             {
-                m_sonarMap[0] = m_ultrasonic.getDistance(Constants::maxDistanceLineTracking);
-                if (m_sonarMap[0] > (Constants::minDetourDistance - Constants::marginObject) && m_sonarMap[0] < (Constants::minDetourDistance + Constants::marginObject))
-                    m_motors.forward(Constants::linearSpeed);
-                else if (m_sonarMap[0] > Constants::minDetourDistance) // Go closer
-                    m_motors.move(calculateSpeed(m_sonarMap[0], 0, 100, Constants::linearSpeed), 0);
-                else // Go further
-                    m_motors.move(0, calculateSpeed(m_sonarMap[0], 0, 100, Constants::linearSpeed));
+                m_sonarMap[0] = m_snapshot.distance;
+                detourControl(m_sonarMap[0]);
             }
         }
         else // Going around finished, line detected, last rotation
         {
-            m_motors.forward(Constants::linearSpeed);
-            delay(Constants::extraTimeLine); // Extra time to over pass the line
+            m_motors.forward(Parameters::get(Param::linearSpeed));
+            Clock::delay(Parameters::get(Param::extraTimeLine)); // Extra time to over pass the line
             m_motors.stop();
             m_servo.write(90); // Look front
-            m_motors.left(Constants::rotateSpeed);
+            m_motors.left(Parameters::get(Param::rotateSpeed));
+            setSonar(0, Constants::maxDistanceLineTracking);
             while (!m_lineTracking.midLine())
-                ; // Keep rotating until you find the line
-            m_state = RobotModeState::START;
+                ; // Keep rotating until you find the line, the loop snapshot is kept
+            setState(RobotModeState::START);
             m_motors.stop();
         }
         break;
     case RobotModeState::ROTATE: // Rotate 90 deg
-        if ((millis() - m_lastUpdate) >= Constants::rotate90Time)
+        if ((m_snapshot.time - m_lastUpdate) >= Parameters::get(Param::rotate90Time))
         {
             m_motors.stop();
-            m_lastUpdate = millis();
-            m_state = RobotModeState::OBSTACLE;
+            m_lastUpdate = m_snapshot.time;
+            m_detourError = 0;
+            m_detourCorner = false;
+            setState(RobotModeState::OBSTACLE);
         }
         break;
-    case RobotModeState::LINELOST:
+    case RobotModeState::LINELOST: // Non-blocking search, most likely places first
     {
-        m_motors.right(Constants::rotateSpeed); // Rotate 180 and find the line
-        delay(Constants::rotate180Time);
-        m_motors.forward(Constants::linearSpeed); // Try and find the line backwards
-
-        // Wait and see if backwards you can find the line
-        unsigned long timeNoLine = millis();
-        while ((millis() - timeNoLine) < Constants::timeLost)
+        if (m_snapshot.lines)
         {
-            if (m_lineTracking.anyLine())
+            m_motors.stop();
+            setState(RobotModeState::START);
+            break;
+        }
+        unsigned long elapsed = m_snapshot.time - m_lastUpdate;
+        switch (m_searchPhase)
+        {
+        case SearchPhase::GAP:
+            m_motors.forward(Parameters::get(Param::linearSpeed));
+            if (elapsed >= Parameters::get(Param::lineGapTime))
+            {
+                m_searchDistance += static_cast<unsigned long>(Parameters::get(Param::lineGapTime)) * Parameters::get(Param::lineSearchSpeed) / 1000;
+                m_searchPhase = SearchPhase::SWEEP;
+                m_lastUpdate = m_snapshot.time;
+            }
+            break;
+        case SearchPhase::SWEEP: // Rotate 45 deg
+            m_searchLeft ? m_motors.left(Parameters::get(Param::rotateSpeed)) : m_motors.right(Parameters::get(Param::rotateSpeed));
+            if (elapsed >= (Parameters::get(Param::rotate90Time) / 2))
+            {
+                m_searchPhase = SearchPhase::SWEEPBACK;
+                m_lastUpdate = m_snapshot.time;
+            }
+            break;
+        case SearchPhase::SWEEPBACK: // Rotate 90 deg, 45 deg past the initial heading
+            m_searchLeft ? m_motors.right(Parameters::get(Param::rotateSpeed)) : m_motors.left(Parameters::get(Param::rotateSpeed));
+            if (elapsed >= Parameters::get(Param::rotate90Time))
+            {
+                m_searchPhase = SearchPhase::SPIRAL;
+                m_lastUpdate = m_snapshot.time;
+            }
+            break;
+        case SearchPhase::SPIRAL:
+        {
+            unsigned short distance = m_searchDistance + elapsed * Parameters::get(Param::lineSearchSpeed) / 1000;
+            if (distance >= Parameters::get(Param::lineSearchDistance)) // Give up
+            {
+                m_motors.stop();
+                setState(RobotModeState::BLOCKED);
                 break;
+            }
+            // Outer side at linearSpeed, inner one at idleSpeed first: the curvature opens with the travelled distance
+            float linearSpeed = Parameters::get(Param::linearSpeed);
+            float idleSpeed = Parameters::get(Param::idleSpeed);
+            float curvature = (linearSpeed - idleSpeed) / (linearSpeed + idleSpeed) * (1 - static_cast<float>(distance) / Parameters::get(Param::lineSearchDistance));
+            m_motors.drive(linearSpeed / (1 + curvature), m_searchLeft ? curvature : -curvature);
+            break;
+        }
+        default:
+            break;
         }
-        m_motors.stop();
-        m_state = RobotModeState::START;
         break;
     }
     case RobotModeState::BLOCKED:
@@ -348,6 +626,8 @@ void Robot::lineTrackingMode()
     default:
         break;
     }
+    bool pinging = (m_state == RobotModeState::START) || (m_state == RobotModeState::FORWARD) || (m_state == RobotModeState::OBSTACLE);
+    setSonar(pinging ? Parameters::get(Param::updateUltrasonicInterval) : 0, Constants::maxDistanceLineTracking);
 }
 
 /**
@@ -358,47 +638,50 @@ void Robot::parkMode()
     for (size_t i{0}; i <= 1; ++i)
     {
         m_servo.write(i * 180);
-        delay(2 * Constants::updateInterval);
-        m_sonarMap[mapAngle(m_servo.read())] = m_ultrasonic.getDistance(Constants::maxDistance);
+        Clock::delay(2 * Parameters::get(Param::updateInterval));
+        m_sonarMap[mapAngle(i * 180)] = ping(Constants::maxDistance);
     }
     if (m_sonarMap[mapAngle(0)] < m_sonarMap[mapAngle(180)]) // Park on the right
         m_servo.write(0);
     else
         m_servo.write(180); // Park on the left
 
-    delay(2 * Constants::updateInterval); // Enough time to move the servo
+    Clock::delay(2 * Parameters::get(Param::updateInterval)); // Enough time to move the servo
 
     // Pass the 1st object
-    while (m_ultrasonic.getDistance(Constants::maxDistance) < Constants::minDistance)
+    unsigned short distance = ping(Constants::maxDistance);
+    while (distance < Parameters::get(Param::minDistance))
     {
-        delay(20);
-        m_motors.forward(Constants::crankSpeed);
+        Clock::delay(20);
+        m_motors.forward(Parameters::get(Param::crankSpeed));
+        distance = ping(Constants::maxDistance);
     }
 
     // Arrive to the second object
-    while (m_ultrasonic.getDistance(Constants::maxDistance) > Constants::minDistance)
+    while (distance > Parameters::get(Param::minDistance))
     {
-        delay(50);
-        m_motors.forward(Constants::crankSpeed);
+        Clock::delay(50);
+        m_motors.forward(Parameters::get(Param::crankSpeed));
+        distance = ping(Constants::maxDistance);
     }
 
-    m_motors.backward(Constants::crankSpeed);
-    delay(Constants::timeMoveAway); // Time to move away
+    m_motors.backward(Parameters::get(Param::crankSpeed));
+    Clock::delay(Parameters::get(Param::timeMoveAway)); // Time to move away
 
     if (m_sonarMap[mapAngle(0)] < m_sonarMap[mapAngle(180)]) // Park on the right
-        m_motors.right(Constants::rotateSpeed);
+        m_motors.right(Parameters::get(Param::rotateSpeed));
     else // Park on the left
-        m_motors.left(Constants::rotateSpeed);
-    delay(Constants::rotate90Time);
+        m_motors.left(Parameters::get(Param::rotateSpeed));
+    Clock::delay(Parameters::get(Param::rotate90Time));
     m_motors.stop();
-    m_motors.forward(Constants::crankSpeed);
-    delay(Constants::timeMoving);
+    m_motors.forward(Parameters::get(Param::crankSpeed));
+    Clock::delay(Parameters::get(Param::timeMoving));
 
     if (m_sonarMap[mapAngle(0)] < m_sonarMap[mapAngle(180)]) // Park on the right
-        m_motors.left(Constants::rotateSpeed);
+        m_motors.left(Parameters::get(Param::rotateSpeed));
     else // Park on the left
-        m_motors.right(Constants::rotateSpeed);
-    delay(Constants::rotate90Time);
+        m_motors.right(Parameters::get(Param::rotateSpeed));
+    Clock::delay(Parameters::get(Param::rotate90Time));
     m_motors.stop();
 }
 
@@ -408,19 +691,417 @@ void Robot::parkMode()
  */
 void Robot::customMode()
 {
-    if (m_servo.read() != 0)
+    setSonar(Parameters::get(Param::updateUltrasonicInterval), Constants::maxDistanceLineTracking);
+    if (m_snapshot.servoAngle != 0)
     {
         m_servo.write(0);
-        delay(300);
+        Clock::delay(300);
         return;
     }
-    m_sonarMap[0] = m_ultrasonic.getDistance(Constants::maxDistanceLineTracking);
-    if (m_sonarMap[0] > (Constants::minDetourDistance - Constants::marginObject) && m_sonarMap[0] < (Constants::minDetourDistance + Constants::marginObject))
-        m_motors.forward(Constants::linearSpeed);
-    else if (m_sonarMap[0] > Constants::minDetourDistance) // Go closer
-        m_motors.move(calculateSpeed(m_sonarMap[0], 0, 100, Constants::linearSpeed), 0);
-    else // Go further
-        m_motors.move(0, Constants::linearSpeed);
+    if (m_snapshot.sonarNew)
+    {
+        m_sonarMap[0] = m_snapshot.distance;
+        detourControl(m_sonarMap[0]);
+    }
+}
+
+/**
+ * @brief Calibration mode. Place the robot 50-100 cm squarely in front of a wall, with a second
+ * wall on its left forming a corner. It measures the servo center, the rotation times and the
+ * minimum speeds, and stores them in EEPROM. A JSON summary is sent through Serial.
+ */
+void Robot::calibrationMode()
+{
+    m_motors.stop();
+    unsigned int servo0 = Parameters::get(Param::servo0);
+    unsigned int servo180 = Parameters::get(Param::servo180);
+    unsigned short rotate90Time, rotate180Time;
+    unsigned char crankSpeed, idleSpeed;
+
+    // The robot must not move before the servo, it must face the wall squarely
+    bool servoDone = calibrateServo(servo0, servo180) && Parameters::set(Param::servo0, servo0) && Parameters::set(Param::servo180, servo180);
+    applyParameters();
+    bool rotationDone = calibrateRotation(rotate90Time, rotate180Time) && Parameters::set(Param::rotate90Time, rotate90Time) && Parameters::set(Param::rotate180Time, rotate180Time);
+    bool speedsDone = calibrateSpeeds(crankSpeed, idleSpeed) && Parameters::set(Param::crankSpeed, crankSpeed) && Parameters::set(Param::idleSpeed, idleSpeed);
+    m_motors.stop();
+    applyParameters();
+    Parameters::save();
+
+    Serial.print(F("{\"N\":130,\"S0\":"));
+    Serial.print(Parameters::get(Param::servo0));
+    Serial.print(F(",\"S180\":"));
+    Serial.print(Parameters::get(Param::servo180));
+    Serial.print(F(",\"R90\":"));
+    Serial.print(Parameters::get(Param::rotate90Time));
+    Serial.print(F(",\"R180\":"));
+    Serial.print(Parameters::get(Param::rotate180Time));
+    Serial.print(F(",\"C\":"));
+    Serial.print(Parameters::get(Param::crankSpeed));
+    Serial.print(F(",\"I\":"));
+    Serial.print(Parameters::get(Param::idleSpeed));
+    Serial.print(F(",\"OK\":"));
+    Serial.print(servoDone | (rotationDone << 1) | (speedsDone << 2)); // Bit per calibration step
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the battery state: {"N":170,"V":voltage,"S":scale,"L":level}, voltage in mV, PWM scale
+ * in 1/256, level 0 none, 1 good, 2 weak, 3 critical.
+ */
+void Robot::replyBattery() const
+{
+    Serial.print(F("{\"N\":170,\"V\":"));
+    Serial.print(m_snapshot.voltage);
+    Serial.print(F(",\"S\":"));
+    Serial.print(m_motors.getVoltageScale());
+    Serial.print(F(",\"L\":"));
+    Serial.print(static_cast<unsigned char>(m_batteryLevel));
+    Serial.println('}');
+}
+
+/**
+ * @brief Send the line tracking laps, the statistics of the last one, the junctions passed in the run
+ * and the recent lap times, newest first:
+ * {"N":160,"L":laps,"T":time,"B":best,"C":corrections,"Lt":lostTime,"Ot":obstacleTime,"Vn":minSpeed,"Vx":maxSpeed,"J":junctions,"R":[times]}, times in ms.
+ * @param reset Forget the laps after sending.
+ */
+void Robot::replyLaps(bool reset)
+{
+    LapStats lastLap{0, 0, 0, 0, 0, 0};
+    if (m_laps)
+        lastLap = m_recentLaps[(m_laps - 1) % Constants::lapHistory];
+    Serial.print(F("{\"N\":160,\"L\":"));
+    Serial.print(m_laps);
+    Serial.print(F(",\"T\":"));
+    Serial.print(lastLap.time);
+    Serial.print(F(",\"B\":"));
+    Serial.print(m_bestLap);
+    Serial.print(F(",\"C\":"));
+    Serial.print(lastLap.corrections);
+    Serial.print(F(",\"Lt\":"));
+    Serial.print(lastLap.lostTime);
+    Serial.print(F(",\"Ot\":"));
+    Serial.print(lastLap.obstacleTime);
+    Serial.print(F(",\"Vn\":"));
+    Serial.print(lastLap.minSpeed);
+    Serial.print(F(",\"Vx\":"));
+    Serial.print(lastLap.maxSpeed);
+    Serial.print(F(",\"J\":"));
+    Serial.print(m_junctions);
+    Serial.print(F(",\"R\":["));
+    for (unsigned short i{0}; (i < m_laps) && (i < Constants::lapHistory); ++i)
+    {
+        if (i)
+            Serial.print(',');
+        Serial.print(m_recentLaps[(m_laps - 1 - i) % Constants::lapHistory].time);
+    }
+    Serial.println(F("]}"));
+    if (reset)
+    {
+        m_bestLap = 0;
+        m_laps = 0;
+        m_lapRunning = false;
+    }
+}
+
+/**
+ * @brief Send the pose, the obstacle grid size, the scans and the escape loops of the current run:
+ * {"N":150,"X":x,"Y":y,"H":heading,"K":cells,"S":scans,"E":loops}, in cm and deg.
+ * @param clear Forget the obstacles after sending.
+ */
+void Robot::replyMap(bool clear)
+{
+    Serial.print(F("{\"N\":150,\"X\":"));
+    Serial.print(static_cast<short>(m_odometry.getX()));
+    Serial.print(F(",\"Y\":"));
+    Serial.print(static_cast<short>(m_odometry.getY()));
+    Serial.print(F(",\"H\":"));
+    Serial.print(static_cast<short>(m_odometry.getHeading() * RAD_TO_DEG));
+    Serial.print(F(",\"K\":"));
+    Serial.print(m_obstacleGrid.count());
+    Serial.print(F(",\"S\":"));
+    Serial.print(m_scans);
+    Serial.print(F(",\"E\":"));
+    Serial.print(m_escapes.getLoops());
+    Serial.println('}');
+    if (clear)
+        m_obstacleGrid.clear();
+}
+
+/**
+ * @brief Find the servo pulse which looks squarely at the wall in front, and move both endpoints
+ * so that it becomes 90 deg. The minimum distance is flat, the middle of the plateau is taken.
+ * @param servo0 0 deg PWM position, updated.
+ * @param servo180 180 deg PWM position, updated.
+ * @return true Endpoints updated.
+ * @return false No wall found.
+ */
+bool Robot::calibrateServo(unsigned int &servo0, unsigned int &servo180)
+{
+    unsigned int center = (servo0 + servo180) / 2;
+    unsigned short bestDistance = Constants::maxDistance;
+    unsigned int first{center}, last{center};
+    for (unsigned int pulse = center - Constants::calibrationServoRange; pulse <= center + Constants::calibrationServoRange; pulse += Constants::calibrationServoStep)
+    {
+        m_servo.writeMicroseconds(pulse);
+        Clock::delay(Parameters::get(Param::updateUltrasonicInterval) * 4); // Let the servo settle
+        unsigned short distance = pingMedian(Constants::maxDistance);
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            first = pulse;
+            last = pulse;
+        }
+        else if (distance == bestDistance)
+            last = pulse;
+    }
+    m_servo.write(90);
+    Clock::delay(2 * Parameters::get(Param::updateInterval)); // Enough time to move the servo
+    if (bestDistance >= Constants::maxDistance)
+        return false;
+
+    int trim = static_cast<int>((first + last) / 2) - static_cast<int>(center);
+    servo0 += trim;
+    servo180 += trim;
+    return true;
+}
+
+/**
+ * @brief Time the rotation watching the distance profile while rotating left in the corner.
+ * The distance has a minimum when facing each wall squarely: the front wall at the start,
+ * the left wall after 90 deg and the front wall again after 360 deg.
+ * @param rotate90Time Time to rotate 90 deg from stopped, updated.
+ * @param rotate180Time Time to rotate 180 deg from stopped, updated.
+ * @return true Times updated.
+ * @return false Profile not recognised before calibrationTimeout.
+ */
+bool Robot::calibrateRotation(unsigned short &rotate90Time, unsigned short &rotate180Time)
+{
+    unsigned short extreme = pingMedian(Constants::maxDistance); // Current minimum or maximum
+    unsigned short frontDistance{0};
+    unsigned long start = Clock::millis();
+    unsigned long extremeTime{start};
+    unsigned long minimumTimes[3]; // Front, left, front
+    unsigned char minima{0};
+    bool searchMinimum{true};
+
+    m_motors.left(Parameters::get(Param::rotateSpeed));
+    while (((Clock::millis() - start) < Constants::calibrationTimeout) && (minima < 3))
+    {
+        unsigned short distance = pingSpaced(Constants::maxDistance);
+        if (distance >= Constants::maxDistance) // Missed echo at big angles
+            continue;
+        if (searchMinimum)
+        {
+            if (distance < extreme)
+            {
+                extreme = distance;
+                extremeTime = m_lastPing;
+            }
+            else if (distance > (extreme + Constants::calibrationThreshold)) // Minimum confirmed
+            {
+                if (minima == 0)
+                    frontDistance = extreme;
+                if ((minima < 2) || (abs(static_cast<short>(extreme) - static_cast<short>(frontDistance)) <= Constants::calibrationThreshold))
+                    minimumTimes[minima++] = extremeTime;
+                extreme = distance;
+                searchMinimum = false;
+            }
+        }
+        else if (distance > extreme)
+            extreme = distance;
+        else if ((distance + Constants::calibrationThreshold) < extreme) // Maximum confirmed
+        {
+            extreme = distance;
+            extremeTime = m_lastPing;
+            searchMinimum = true;
+        }
+    }
+    m_motors.stop();
+    if (minima < 3)
+        return false;
+
+    unsigned long quarterTime = (minimumTimes[2] - minimumTimes[1]) / 3; // Rotating at constant speed
+    rotate90Time = minimumTimes[1] - start;
+    rotate180Time = rotate90Time + quarterTime;
+    return true;
+}
+
+/**
+ * @brief Find the crank speed ramping up the PWM until the distance to the wall in front starts
+ * changing, and the idle speed ramping it down until it stops changing.
+ * @param crankSpeed Minimum crank speed, updated.
+ * @param idleSpeed Minimum idle speed, updated.
+ * @return true Speeds updated.
+ * @return false Not enough room in front or the robot did not move.
+ */
+bool Robot::calibrateSpeeds(unsigned char &crankSpeed, unsigned char &idleSpeed)
+{
+    unsigned short startDistance = pingMedian(Constants::maxDistance);
+    if ((startDistance < 2 * Parameters::get(Param::minDistance)) || (startDistance >= Constants::maxDistance))
+        return false;
+
+    m_motors.setMinSpeeds(0, 0); // Raw PWM
+    unsigned short speed{0};
+    unsigned short distance{startDistance};
+    while ((static_cast<short>(startDistance) - static_cast<short>(distance)) < Constants::calibrationMoved)
+    {
+        speed += Constants::calibrationStep;
+        if (speed > 255)
+        {
+            m_motors.stop();
+            return false;
+        }
+        m_motors.forward(speed);
+        Clock::delay(Constants::calibrationStepTime);
+        distance = pingMedian(Constants::maxDistance);
+    }
+    crankSpeed = min(speed + Constants::calibrationMargin, 255);
+
+    // Keep moving while slowing down, the distance is measured over two steps at low speeds
+    unsigned short previousDistance{distance};
+    while ((speed > Constants::calibrationStep) && (distance > Parameters::get(Param::minDistance)))
+    {
+        speed -= Constants::calibrationStep;
+        m_motors.forward(speed);
+        Clock::delay(2 * Constants::calibrationStepTime);
+        distance = pingMedian(Constants::maxDistance);
+        if ((static_cast<short>(previousDistance) - static_cast<short>(distance)) < Constants::calibrationMoved) // Stopped
+            break;
+        previousDistance = distance;
+    }
+    m_motors.stop();
+    idleSpeed = min(speed + Constants::calibrationStep + Constants::calibrationMargin, crankSpeed);
+    return true;
+}
+
+/**
+ * @brief Measure the distance three times and return the median, rejecting single bad echoes.
+ * @param maxDistance Maximum measured distance.
+ * @return unsigned short Median distance in cm.
+ */
+unsigned short Robot::pingMedian(unsigned short maxDistance)
+{
+    unsigned short a = pingSpaced(maxDistance);
+    unsigned short b = pingSpaced(maxDistance);
+    unsigned short c = pingSpaced(maxDistance);
+    return max(min(a, b), min(max(a, b), c));
+}
+
+/**
+ * @brief Ping with the servo sonar once calibrationPingPeriod has passed since the previous ping.
+ * For the blocking sequences, which would otherwise read the late echoes of the previous ping as
+ * near ranges.
+ * @param maxDistance Maximum measured distance.
+ * @return unsigned short Distance in cm.
+ */
+unsigned short Robot::pingSpaced(unsigned short maxDistance)
+{
+    while ((Clock::millis() - m_lastPing) < Constants::calibrationPingPeriod)
+        ;
+    return ping(maxDistance);
+}
+
+/**
+ * @brief Change the mode state, recording the transition.
+ * @param state New state.
+ */
+void Robot::setState(RobotModeState state)
+{
+    if (state != m_state)
+        FlightRecorder::log(FlightEvent::STATE, static_cast<unsigned char>(state));
+    m_state = state;
+}
+
+/**
+ * @brief Steer away from the obstacles while moving: the closer the sides, the larger the
+ * curvature towards the other side, and the closer the front, the lower the speed. The
+ * obstacles known from previous runs count as if they were seen.
+ * @return true Moving.
+ * @return false Time to collision critical, motors untouched.
+ */
+bool Robot::steerControl()
+{
+    static constexpr unsigned char angles[5]{0, 30, 90, 150, 180}; // Servo angles of m_sonarMap
+    unsigned short steerDistance = Parameters::get(Param::steerDistance);
+    unsigned short distances[5];
+    for (unsigned char i{0}; i < 5; ++i)
+    {
+        float heading = m_odometry.getHeading() + (static_cast<short>(angles[i]) - 90) * DEG_TO_RAD;
+        distances[i] = min(m_sonarMap[i], m_obstacleGrid.raycast(m_odometry.getX(), m_odometry.getY(), heading, steerDistance));
+    }
+
+    // Closeness of each direction: 0 beyond steerDistance, 1 touching
+    float closeness[5];
+    for (unsigned char i{0}; i < 5; ++i)
+        closeness[i] = (distances[i] < steerDistance) ? static_cast<float>(steerDistance - distances[i]) / steerDistance : 0;
+
+    // Curvature, positive left: obstacles on the right (0 and 30 deg) bend the path left
+    float curvature = closeness[0] / 2 + closeness[1] - closeness[3] - closeness[4] / 2;
+    bool openLeft = (distances[3] + distances[4]) >= (distances[0] + distances[1]);
+    curvature += (openLeft ? 2 : -2) * closeness[2]; // Obstacle in front, towards the most open side
+    curvature = constrain(curvature, -1, 1);
+
+    // Stopping before the obstacle in front, or closing in too fast: stop and scan
+    unsigned char crankSpeed = Parameters::get(Param::crankSpeed);
+    unsigned char speed = m_governor.limit(m_snapshot.time, distances[2], frontApproach(), Parameters::get(Param::stopMargin), crankSpeed, 255);
+    unsigned short timeToCollision = m_rangeEstimators[2].isValid() ? SpeedGovernor::getTimeToCollision(m_sonarMap[2], m_rangeEstimators[2].getRate(commandedRate(2))) : 0xFFFF;
+    if ((speed == 0) || (timeToCollision < Parameters::get(Param::criticalTime)))
+        return false;
+    speed = crankSpeed + (speed - crankSpeed) * (1 - fabs(curvature) / 2); // Slower when turning
+    m_motors.drive(speed, curvature);
+    return true;
+}
+
+/**
+ * @brief Add a ping to the obstacle grid. A ping of a known obstacle first corrects the position
+ * drift along the beam.
+ * @param angle Servo angle.
+ * @param distance Measured distance.
+ */
+void Robot::mapReading(unsigned char angle, unsigned short distance)
+{
+    float heading = m_odometry.getHeading() + (static_cast<short>(angle) - 90) * DEG_TO_RAD;
+    if (distance < Constants::maxDistance)
+    {
+        unsigned short range = distance + Constants::mapGate;
+        unsigned short known = m_obstacleGrid.raycast(m_odometry.getX(), m_odometry.getY(), heading, range);
+        if ((known < range) && ((known + Constants::mapGate) > distance)) // Closer than known: the robot is ahead
+        {
+            float shift = (static_cast<short>(known) - static_cast<short>(distance)) * Constants::mapCorrection / 100.0;
+            m_odometry.correct(shift * cos(heading), shift * sin(heading));
+        }
+    }
+    m_obstacleGrid.addReading(m_odometry.getX(), m_odometry.getY(), heading, distance, Constants::maxDistance);
+}
+
+/**
+ * @brief Set the pings taken by acquireSensors() for the mode.
+ * @param interval Time between pings, 0 for none.
+ * @param maxDistance Maximum distance.
+ */
+void Robot::setSonar(unsigned short interval, unsigned short maxDistance)
+{
+    m_pingInterval = interval;
+    m_pingMaxDistance = maxDistance;
+}
+
+/**
+ * @brief Ping now with the servo sonar. The modes get their pings from acquireSensors(), the
+ * blocking sequences call it directly and leave the loop snapshot untouched.
+ * @param maxDistance Maximum distance.
+ * @return unsigned short Distance in cm.
+ */
+unsigned short Robot::ping(unsigned short maxDistance)
+{
+    bool sideways = Constants::sideSonars && (m_servo.read() != 90); // It could hear the side sonars
+    if (sideways)
+        UltrasonicArray::wait();
+    unsigned short distance = m_ultrasonic.getDistance(maxDistance);
+    m_lastPing = Clock::millis();
+    if (sideways)
+        UltrasonicArray::hold();
+    return distance;
 }
 
 /**
@@ -447,6 +1128,49 @@ unsigned char Robot::mapAngle(unsigned char angle) const
     }
 }
 
+/**
+ * @brief Rate of change of the distance expected from the commanded speed of the loop snapshot in a
+ * m_sonarMap direction.
+ * @param index Position in the m_sonarMap array.
+ * @return float Rate (cm/s), negative when closing in.
+ */
+float Robot::commandedRate(unsigned char index) const
+{
+    static constexpr float cosines[5]{0, 0.5, 1, 0.5, 0}; // Projection of the forward speed
+    float speed = (m_snapshot.leftSpeed + m_snapshot.rightSpeed) / 2.0 * Constants::fullSpeed / 255;
+    return -speed * cosines[index];
+}
+
+/**
+ * @brief Speed of the obstacle in front coming closer by itself: the closing rate of the front
+ * estimator not explained by the commanded speed.
+ * @return float Approach speed (cm/s), 0 without estimate.
+ */
+float Robot::frontApproach() const
+{
+    float ownRate = commandedRate(2);
+    return ownRate - m_rangeEstimators[2].getRate(ownRate);
+}
+
+/**
+ * @brief Refresh the m_sonarMap array with the current estimates of all directions.
+ */
+void Robot::updateSonarMap()
+{
+    for (unsigned char i{0}; i < 5; ++i)
+        m_sonarMap[i] = m_rangeEstimators[i].predict(m_snapshot.time, commandedRate(i), Constants::maxDistance);
+}
+
+/**
+ * @brief Reset a direction of the m_sonarMap array and its estimator.
+ * @param index Position in the m_sonarMap array.
+ */
+void Robot::resetSonarMap(unsigned char index)
+{
+    m_rangeEstimators[index].reset();
+    m_sonarMap[index] = Constants::maxDistance;
+}
+
 /**
  * @brief Move the servo for the obstable avoidance mode.
  */
@@ -470,14 +1194,360 @@ void Robot::moveServoSequence() // Sequences: {90, 150, 90, 30} {90, 180, 90, 0}
 }
 
 /**
- * @brief Calculate a limited linear robot speed based on the object distance in front.
- * @param distance Object distance.
- * @param minDistance Minimum distance.
- * @param maxDistance Maxiumn distance.
- * @param minSpeed Minimum speed.
- * @return unsigned char Calculated speed.
+ * @brief Keep minDetourDistance to the object on the right with a PD controller on the side distance.
+ * It must be called at a fixed ping rate, so the derivative term is the distance change per ping.
+ * When the next distance is predicted to jump over cornerDistance, the object side is ending and the
+ * robot turns around the corner with a fixed arc until the next side is seen.
+ * @param distance Side distance to the object (cm).
+ */
+void Robot::detourControl(unsigned short distance)
+{
+    short cornerDistance = Parameters::get(Param::cornerDistance);
+    short linearSpeed = Parameters::get(Param::linearSpeed);
+    short error = static_cast<short>(distance) - static_cast<short>(Parameters::get(Param::minDetourDistance)); // Positive too far
+    if (abs(error) <= static_cast<short>(Parameters::get(Param::marginObject)))
+        error = 0;
+
+    if ((error + (error - m_detourError)) > cornerDistance) // Predicted next error: end of the object side
+        m_detourCorner = true;
+    else if (error < cornerDistance) // Next side of the object found
+        m_detourCorner = false;
+
+    if (m_detourCorner)
+    {
+        m_detourError = 0; // Avoid a derivative kick when the next side is found
+        float ratio = Parameters::get(Param::cornerRatio) / 100.0; // Right side over the left one
+        m_motors.drive(linearSpeed * (1 + ratio) / 2, (ratio - 1) / (ratio + 1)); // Left side at linearSpeed
+        return;
+    }
+
+    long correction = static_cast<long>(Parameters::get(Param::detourKp)) * error + static_cast<long>(Parameters::get(Param::detourKd)) * (error - m_detourError); // Over 16 bits at the parameter limits
+    m_detourError = error;
+
+    // Keep both sides moving, differential speeds only
+    long maxCorrection = max(linearSpeed - static_cast<short>(Parameters::get(Param::idleSpeed)), 0);
+    correction = constrain(correction, -maxCorrection, maxCorrection);
+    m_motors.moveVector(linearSpeed, static_cast<short>(-correction));
+}
+
+/**
+ * @brief Control tick trampoline, called from the Timer1 interrupt.
+ * @param robot Robot.
+ */
+void Robot::controlTick(void *robot)
+{
+    static_cast<Robot *>(robot)->lineFollowerTick();
+}
+
+/**
+ * @brief Inner line follower loop, run at a fixed rate from the control tick. It owns the motors
+ * between a START command and a STOP command or a line lost report.
+ */
+void Robot::lineFollowerTick()
+{
+    ++m_ticks;
+    LineCommand command;
+    while (m_lineCommands.pop(command))
+    {
+        if (command.type == LineCommandType::SPEED)
+        {
+            m_lineFollower.speed = command.speed;
+            m_lineFollower.rotateSpeed = command.rotateSpeed;
+            m_lineFollower.crossingTicks = command.crossingTicks;
+            m_lineFollower.branchTicks = command.branchTicks;
+            m_lineFollower.overshootTicks = command.overshootTicks;
+            continue;
+        }
+        if (command.type == LineCommandType::RESET)
+        {
+            m_lineBias = 0;
+            m_junctions = 0; // Route from the start
+        }
+        if (command.type == LineCommandType::START)
+        {
+            m_lineLostTicks = 0;
+            m_junctionPhase = JunctionPhase::NONE;
+            m_lineMarker = false;
+        }
+        m_lineFollower = command;
+    }
+    if (m_lineFollower.type != LineCommandType::START)
+        return;
+
+    unsigned char lines = m_lineTracking.read(); // Own reading, the snapshot belongs to the main loop
+    bool left = lines & LineTracking::s_left;
+    bool right = lines & LineTracking::s_right;
+    bool mid = lines & LineTracking::s_mid;
+    if (left || right || mid)
+        m_lineLostTicks = 0;
+    bool marker = (lines == LineTracking::s_all);
+    if (marker && !m_lineMarker) // Timed here, the main loop can miss a marker crossed between two passes
+        m_lapMarkers.push(m_ticks);
+    m_lineMarker = marker;
+
+    if (junctionTick(lines)) // Start/finish marker and junctions
+        return;
+    if (left)
+    {
+        if (!m_motors.isRotatingLeft())
+            ++m_lineCorrections;
+        if (!m_motors.isRotatingLeft() && (m_lineBias < Constants::lineBiasMax))
+            ++m_lineBias;
+        m_lineLeft = true;
+        m_motors.left(m_lineFollower.rotateSpeed);
+    }
+    else if (right)
+    {
+        if (!m_motors.isRotatingRight())
+            ++m_lineCorrections;
+        if (!m_motors.isRotatingRight() && (m_lineBias > -Constants::lineBiasMax))
+            --m_lineBias;
+        m_lineLeft = false;
+        m_motors.right(m_lineFollower.rotateSpeed);
+    }
+    else if (mid)
+        m_motors.forward(m_lineFollower.speed);
+    else if (++m_lineLostTicks >= m_lineFollower.lostTicks) // Keep the last correction to avoid line missing in between sensors
+    {
+        bool lostInFront = !m_motors.isRotatingLeft() && !m_motors.isRotatingRight();
+        LineEvent event{(lostInFront && (m_lineBias != 0)) ? (m_lineBias > 0) : m_lineLeft, lostInFront, false};
+        m_lineFollower.type = LineCommandType::STOP; // Main program takes the motors back
+        m_lineEvents.push(event);
+    }
+}
+
+/**
+ * @brief Junction handling of the line follower tick, by the timing of the line sensor edges. An
+ * outer sensor finding a line while the middle one keeps it starts a crossing: the robot goes
+ * straight collecting the branches seen, those an outer sensor saw for Constants::junctionMinTime
+ * at least. If the middle sensor loses the line first, or an outer sensor stays on longer than
+ * Constants::junctionTime, it was a curve and the line follower corrects it. When the outer sensors
+ * leave the branches, the middle sensor tells if the line goes on. The times are scaled by the speed.
+ * @param lines Line sensors.
+ * @return true Motors driven by the junction handling.
+ * @return false Follow the line.
+ */
+bool Robot::junctionTick(unsigned char lines)
+{
+    bool mid = lines & LineTracking::s_mid;
+    unsigned char outer = lines & (LineTracking::s_left | LineTracking::s_right);
+    switch (m_junctionPhase)
+    {
+    case JunctionPhase::NONE:
+        if (!mid || !outer)
+            return false;
+        m_junctionPhase = JunctionPhase::CROSSING;
+        m_junctionWays = 0;
+        m_junctionTicks = 0;
+        m_branchTicks[0] = 0;
+        m_branchTicks[1] = 0;
+        // fall through
+    case JunctionPhase::CROSSING:
+        if (outer)
+        {
+            static constexpr unsigned char sides[2]{LineTracking::s_left, LineTracking::s_right};
+            for (unsigned char i{0}; i < 2; ++i)
+            {
+                if ((outer & sides[i]) && (++m_branchTicks[i] >= m_lineFollower.branchTicks)) // Not a graze
+                {
+                    m_branchTicks[i] = m_lineFollower.branchTicks;
+                    m_junctionWays |= sides[i];
+                }
+            }
+            if (!mid || (++m_junctionTicks > m_lineFollower.crossingTicks)) // The line turns, or runs along the outer sensor
+            {
+                m_junctionPhase = JunctionPhase::CURVE;
+                return false;
+            }
+            m_motors.forward(m_lineFollower.speed);
+            return true;
+        }
+        if (mid)
+            m_junctionWays |= LineTracking::s_mid; // The line goes on
+        return takeJunction();
+    case JunctionPhase::CURVE:
+        if (!outer)
+            m_junctionPhase = JunctionPhase::NONE;
+        return false;
+    case JunctionPhase::OVERSHOOT:
+        if (++m_junctionTicks < m_lineFollower.overshootTicks)
+        {
+            m_motors.forward(m_lineFollower.speed);
+            return true;
+        }
+        m_junctionTicks = 0;
+        m_junctionPhase = mid ? JunctionPhase::LEAVE : JunctionPhase::FIND;
+        // fall through
+    case JunctionPhase::LEAVE:
+    case JunctionPhase::FIND:
+        if (m_junctionPhase == JunctionPhase::LEAVE)
+        {
+            if (!mid)
+                m_junctionPhase = JunctionPhase::FIND;
+        }
+        else if (mid) // On the branch, followed once the outer sensors leave the junction
+        {
+            m_junctionPhase = JunctionPhase::CURVE;
+            m_lineLeft = m_junctionLeft;
+            return false;
+        }
+        if (++m_junctionTicks > m_lineFollower.turnTicks) // Branch not found, handled as a lost line
+        {
+            m_junctionPhase = JunctionPhase::NONE;
+            return false;
+        }
+        m_junctionLeft ? m_motors.left(m_lineFollower.rotateSpeed) : m_motors.right(m_lineFollower.rotateSpeed);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Take the ways found crossing: two or more are a junction, which takes the next turn of
+ * the route, straight on by default. A requested way which is not there is replaced by straight
+ * on, or else by the left branch. A single branch is a corner, turned without searching the line.
+ * @return true Motors driven by the junction handling.
+ * @return false Follow the line.
+ */
+bool Robot::takeJunction()
+{
+    bool left = m_junctionWays & LineTracking::s_left;
+    bool right = m_junctionWays & LineTracking::s_right;
+    bool straight = m_junctionWays & LineTracking::s_mid;
+    m_junctionPhase = JunctionPhase::NONE;
+    if (left + right + straight < 2)
+    {
+        if (straight || (!left && !right)) // Only the line followed
+            return false;
+        m_junctionLeft = left;
+    }
+    else
+    {
+        Turn turn = Routes::get(m_junctions);
+        if (m_junctions < 255)
+            ++m_junctions;
+        if (turn == Turn::STOP)
+        {
+            m_motors.stop();
+            m_lineFollower.type = LineCommandType::STOP; // Main program takes the motors back
+            m_lineEvents.push(LineEvent{m_lineLeft, false, true});
+            return true;
+        }
+        if ((turn == Turn::LEFT) && left)
+            m_junctionLeft = true;
+        else if ((turn == Turn::RIGHT) && right)
+            m_junctionLeft = false;
+        else if (straight)
+            return false;
+        else
+            m_junctionLeft = left;
+    }
+    m_junctionPhase = JunctionPhase::OVERSHOOT;
+    m_junctionTicks = 0;
+    m_motors.forward(m_lineFollower.speed);
+    return true;
+}
+
+/**
+ * @brief Send a command to the line follower of the control tick. Stop it before any motor command.
+ * @param type Command.
+ * @param speed Forward speed.
+ */
+void Robot::followLine(LineCommandType type, unsigned char speed)
+{
+    LineCommand command{type, speed, static_cast<unsigned char>(Parameters::get(Param::rotateSpeed)),
+                        static_cast<unsigned short>(static_cast<unsigned long>(Parameters::get(Param::timeUntilLost)) * 1000 / Constants::controlTickPeriod),
+                        static_cast<unsigned short>(static_cast<unsigned long>(Parameters::get(Param::rotate180Time)) * 1000 / Constants::controlTickPeriod),
+                        junctionTicks(Constants::junctionTime, speed), junctionTicks(Constants::junctionMinTime, speed),
+                        junctionTicks(Constants::junctionOvershoot, speed)};
+    while (!m_lineCommands.push(command))
+        ; // Emptied by the next tick
+    if (m_lapRunning && ((type == LineCommandType::START) || (type == LineCommandType::SPEED)))
+    {
+        m_lap.minSpeed = min(m_lap.minSpeed, speed);
+        m_lap.maxSpeed = max(m_lap.maxSpeed, speed);
+    }
+}
+
+/**
+ * @brief Convert a junction time measured at Constants::linearSpeed into control ticks at another
+ * speed, as the distance travelled is the same.
+ * @param time Time at Constants::linearSpeed (ms).
+ * @param speed Commanded forward speed, 0 for Constants::linearSpeed.
+ * @return unsigned short Control ticks.
+ */
+unsigned short Robot::junctionTicks(unsigned char time, unsigned char speed)
+{
+    if (speed == 0)
+        speed = Constants::linearSpeed;
+    return static_cast<unsigned long>(time) * 1000 * Constants::linearSpeed / (static_cast<unsigned long>(Constants::controlTickPeriod) * speed);
+}
+
+/**
+ * @brief Start timing a lap from the start/finish marker.
+ * @param tick Control tick of the marker crossing.
+ */
+void Robot::startLap(unsigned long tick)
+{
+    m_lapRunning = true;
+    m_lapStart = tick;
+    m_lapClock = m_snapshot.time;
+    m_lap = LapStats{0, 0, 0, 0, 255, 0}; // Speeds from the next commands
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        m_lineCorrections = 0;
+    }
+}
+
+/**
+ * @brief Time the lap: the marker is a bar across the track which all the line sensors see while
+ * following the line, reported by the control tick with its tick. Accumulate the time out of the line.
+ */
+void Robot::updateLap()
+{
+    if (m_lapRunning)
+    {
+        unsigned long elapsed = m_snapshot.time - m_lapClock;
+        m_lapClock = m_snapshot.time;
+        if (m_state == RobotModeState::LINELOST)
+            m_lap.lostTime += elapsed;
+        else if ((m_state == RobotModeState::ROTATE) || (m_state == RobotModeState::OBSTACLE))
+            m_lap.obstacleTime += elapsed;
+    }
+
+    unsigned long tick;
+    while (m_lapMarkers.pop(tick))
+    {
+        if (!m_lapRunning)
+        {
+            startLap(tick);
+            continue;
+        }
+        unsigned long time = (tick - m_lapStart) * Constants::controlTickPeriod / 1000;
+        if (time < Constants::lapMinTime)
+            continue;
+        m_lap.time = time;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            m_lap.corrections = m_lineCorrections;
+        }
+        m_recentLaps[m_laps % Constants::lapHistory] = m_lap;
+        if ((m_bestLap == 0) || (m_lap.time < m_bestLap))
+            m_bestLap = m_lap.time;
+        ++m_laps;
+        startLap(tick);
+    }
+}
+
+/**
+ * @brief Start the line search, on the likely side of the line.
+ * @param event Line lost report.
  */
-unsigned char Robot::calculateSpeed(unsigned short distance, unsigned short minDistance, unsigned short maxDistance, unsigned char minSpeed) const
+void Robot::startLineSearch(const LineEvent &event)
 {
-    return minSpeed + static_cast<unsigned char>((distance - minDistance) * (255 - minSpeed) / (maxDistance - minDistance));
+    m_searchLeft = event.searchLeft;
+    m_searchPhase = event.lostInFront ? SearchPhase::GAP : SearchPhase::SWEEP;
+    m_searchDistance = 0;
+    m_lastUpdate = m_snapshot.time;
+    setState(RobotModeState::LINELOST);
 }
@@ -0,0 +1,107 @@
+/**
+ * @file routes.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Route table of the line tracking mode: the turn to take at each junction, stored in EEPROM.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include "routes.h"
+
+Turn Routes::s_turns[Routes::s_size];
+unsigned char Routes::s_length{0};
+
+/**
+ * @brief CRC-16 of a route, version and length included.
+ * @param length Number of turns.
+ * @param turns Turns.
+ * @return unsigned short CRC.
+ */
+unsigned short Routes::crc(unsigned char length, const Turn *turns)
+{
+    unsigned short crc = _crc16_update(0xFFFF, s_version);
+    crc = _crc16_update(crc, length);
+    for (unsigned char i{0}; i < length; ++i)
+        crc = _crc16_update(crc, static_cast<unsigned char>(turns[i]));
+    return crc;
+}
+
+/**
+ * @brief Return the number of junctions in the route.
+ * @return unsigned char Length, 0 for no route.
+ */
+unsigned char Routes::getLength()
+{
+    return s_length;
+}
+
+/**
+ * @brief Write turns from a junction on, the route ends after them. Use save() to keep it after a reset.
+ * @param junction Index of the first turn, up to the current length to append.
+ * @param turns Turn letters: S straight, L left, R right, E end.
+ * @return true Route changed.
+ * @return false Index, length or letter not valid, the route is kept.
+ */
+bool Routes::set(unsigned char junction, const char *turns)
+{
+    if ((turns == nullptr) || (junction > s_length))
+        return false;
+    size_t length = strlen(turns);
+    if (junction + length > s_size)
+        return false;
+    for (size_t i{0}; i < length; ++i)
+    {
+        Turn turn = static_cast<Turn>(turns[i]);
+        if ((turn != Turn::STRAIGHT) && (turn != Turn::LEFT) && (turn != Turn::RIGHT) && (turn != Turn::STOP))
+            return false;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // Read by the control tick
+    {
+        for (size_t i{0}; i < length; ++i)
+            s_turns[junction + i] = static_cast<Turn>(turns[i]);
+        s_length = junction + length;
+    }
+    return true;
+}
+
+/**
+ * @brief Load the route from EEPROM. No route if the stored version, length or CRC is not valid.
+ * @return true Route loaded from EEPROM.
+ * @return false No route.
+ */
+bool Routes::load()
+{
+    s_length = 0;
+    unsigned char version = EEPROM.read(s_address);
+    unsigned char length = EEPROM.read(s_address + 1);
+    unsigned short storedCrc;
+    EEPROM.get(s_address + 2, storedCrc);
+    if ((version != s_version) || (length > s_size))
+        return false;
+
+    Turn turns[s_size];
+    for (unsigned char i{0}; i < length; ++i)
+        turns[i] = static_cast<Turn>(EEPROM.read(s_address + 4 + i));
+    if (crc(length, turns) != storedCrc)
+        return false;
+    memcpy(s_turns, turns, length);
+    s_length = length;
+    return true;
+}
+
+/**
+ * @brief Save the route in EEPROM, only writing the bytes which changed.
+ */
+void Routes::save()
+{
+    EEPROM.update(s_address, s_version);
+    EEPROM.update(s_address + 1, s_length);
+    EEPROM.put(s_address + 2, crc(s_length, s_turns));
+    for (unsigned char i{0}; i < s_length; ++i)
+        EEPROM.update(s_address + 4 + i, static_cast<unsigned char>(s_turns[i]));
+}
\ No newline at end of file
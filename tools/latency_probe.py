@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+@file latency_probe.py
+@author José Ángel Sánchez (https://github.com/gelanchez)
+@brief Round-trip latency probe for the robot serial/Bluetooth link.
+@version 1.0.0
+@date 2026-10-19
+@copyright GPL-3.0
+
+Sends {"N":110} pings through a serial port or pty and prints the latency percentiles,
+split into the time spent on the link and the time the frame waited on the robot.
+The robot statistics ({"N":111}) are printed at the end.
+
+Usage:
+    python3 tools/latency_probe.py /dev/ttyUSB0 --count 200 --interval 0.05
+
+To try it without the robot, create a pty pair with
+    socat -d -d pty,raw,echo=0 pty,raw,echo=0
+and answer the frames from the other end.
+"""
+
+import argparse
+import json
+import os
+import select
+import sys
+import termios
+import time
+
+BAUDS = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+}
+
+
+def open_port(path, baud):
+    """Open the serial port or pty in raw mode."""
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0  # iflag
+    attrs[1] = 0  # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL  # cflag
+    attrs[3] = 0  # lflag
+    attrs[4] = attrs[5] = BAUDS[baud]
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def read_frame(fd, buffer, timeout):
+    """Read bytes until a complete JSON frame is available. Return (frame, time) or (None, None)."""
+    deadline = time.monotonic() + timeout
+    while True:
+        start = buffer.find(b"{")
+        end = buffer.find(b"}", start)
+        if start >= 0 and end >= 0:
+            frame = bytes(buffer[start:end + 1])
+            del buffer[:end + 1]
+            return frame, time.monotonic()
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return None, None
+        ready, _, _ = select.select([fd], [], [], remaining)
+        if ready:
+            buffer.extend(os.read(fd, 256))
+
+
+def percentile(values, p):
+    """Nearest-rank percentile."""
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    rank = max(0, min(len(ordered) - 1, int(round(p / 100.0 * len(ordered) + 0.5)) - 1))
+    return ordered[rank]
+
+
+def print_row(name, values):
+    print("{:<22}{:>9.2f}{:>9.2f}{:>9.2f}{:>9.2f}{:>9.2f}".format(
+        name, percentile(values, 50), percentile(values, 90), percentile(values, 99),
+        min(values) if values else float("nan"), max(values) if values else float("nan")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("port", help="Serial port or pty path")
+    parser.add_argument("--baud", type=int, default=9600, choices=sorted(BAUDS))
+    parser.add_argument("--count", type=int, default=100, help="Number of pings")
+    parser.add_argument("--interval", type=float, default=0.1, help="Time between pings (s)")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Reply timeout (s)")
+    parser.add_argument("--reset", action="store_true", help="Reset the robot statistics first")
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    buffer = bytearray()
+    if args.reset:
+        os.write(fd, b'{"N":111,"D1":1}')
+        read_frame(fd, buffer, args.timeout)
+
+    rtts, waits, processing, links, wires = [], [], [], [], []
+    lost = 0
+    previous_rtt = 0
+    for sequence in range(1, args.count + 1):
+        ping = '{{"N":110,"D1":{},"D2":{}}}'.format(sequence, int(round(previous_rtt))).encode()
+        sent = time.monotonic()
+        os.write(fd, ping)
+        while True:
+            frame, received = read_frame(fd, buffer, args.timeout)
+            if frame is None:
+                lost += 1
+                break
+            try:
+                reply = json.loads(frame)
+            except ValueError:
+                continue
+            if reply.get("N") != 110 or reply.get("D1") != sequence:
+                continue  # Late reply or unrelated frame
+            rtt = (received - sent) * 1000.0
+            device = ((reply["P"] - reply["R"]) % 2**32) / 1000.0
+            wait = min(reply["L"] / 1000.0, rtt)  # Upper bound of the time waiting for the next drain
+            wire = 10.0 * (len(ping) + len(frame) + 2) / args.baud * 1000.0  # 8N1 serialization time
+            rtts.append(rtt)
+            processing.append(device)
+            waits.append(wait)
+            wires.append(wire)
+            links.append(max(0.0, rtt - device - wait - wire))
+            previous_rtt = rtt
+            break
+        time.sleep(args.interval)
+
+    print("{} pings, {} lost, {:.1f} ms of UART serialization per round trip @ {} bps".format(
+        args.count, lost, sum(wires) / len(wires) if wires else float("nan"), args.baud))
+    print("{:<22}{:>9}{:>9}{:>9}{:>9}{:>9}".format("(ms)", "p50", "p90", "p99", "min", "max"))
+    print_row("round trip", rtts)
+    print_row("robot loop wait (<=)", waits)
+    print_row("robot processing", processing)
+    print_row("link/BLE remainder", links)
+
+    os.write(fd, b'{"N":111}')
+    while True:
+        frame, _ = read_frame(fd, buffer, args.timeout)
+        if frame is None:
+            print("No statistics received", file=sys.stderr)
+            break
+        try:
+            stats = json.loads(frame)
+        except ValueError:
+            continue
+        if stats.get("N") == 111:
+            print("robot: frames {F}, coalesced {C}, dropped {D}, malformed {M}, RX overflows {O}".format(**stats))
+            print("robot: gap avg {G} ms max {Gx} ms, RTT avg {T} ms max {Tx} ms, drain max {Lx} ms".format(**stats))
+            break
+    os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,184 @@
+/**
+ * @file echotest.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Check of UltrasonicArray::echo() with synthetic echo edges on port C, on the virtual MCU.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ *
+ * Usage:
+ *     echotest
+ *
+ * The side sonars are added as on the robot, both in the same group. Each case pings them, drives
+ * their echo pins at given times after the trigger and checks the distances stored. Exit status 1
+ * if any case fails.
+ */
+
+#include <Arduino.h>
+#include <cstdio>
+#include "constants.h"
+#include "mcu.h"
+#include "ultrasonicarray.h"
+
+extern "C" void PCINT1_vect(void); // UltrasonicArray::echo()
+
+namespace
+{
+    constexpr unsigned short s_maxDistance{250};
+    constexpr uint8_t s_right{digitalPinToBitMask(Pins::rightEchoPin)};
+    constexpr uint8_t s_left{digitalPinToBitMask(Pins::leftEchoPin)};
+    constexpr uint8_t s_other{digitalPinToBitMask(Pins::echoPin)}; // Servo sonar, not watched
+    constexpr double s_waitStep{50};                                   // Polling of update() (us)
+
+    /**
+     * @brief Hardware without physics, the echo pins are driven by the cases.
+     */
+    class Bench : public sim::Hardware
+    {
+    public:
+        void update(double) override {}
+        void setMotors(short, short) override {}
+        void setServo(unsigned short) override {}
+        unsigned long trigger() override { return 0; }
+        bool isOnLine(unsigned char) override { return false; }
+        unsigned short readBattery() override { return 0; }
+    };
+
+    /**
+     * @brief Echo pin change at a time after the trigger.
+     */
+    struct Edge
+    {
+        double time; // From the trigger (us)
+        uint8_t pins; // Port C after the change
+    };
+
+    /**
+     * @brief Change port C, raising the pin change interrupt as the AVR does for the watched pins.
+     * @param pins New port C.
+     */
+    void drive(uint8_t pins)
+    {
+        uint8_t changed = PINC ^ pins;
+        PINC = pins;
+        if ((PCICR & _BV(PCIE1)) && (changed & PCMSK1))
+            PCINT1_vect();
+    }
+
+    /**
+     * @brief Call update() until a group is stored.
+     * @param limit Maximum wait (us).
+     * @return true Group stored.
+     * @return false Nothing within the limit.
+     */
+    bool waitUpdate(double limit)
+    {
+        for (double waited{0}; waited < limit; waited += s_waitStep)
+        {
+            if (UltrasonicArray::update())
+                return true;
+            sim::mcu().advanceMicros(s_waitStep);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Expected distance of an echo pulse, with the firmware arithmetic in Timer1 ticks.
+     * @param pulse Echo pulse (us).
+     * @return unsigned short Distance (cm).
+     */
+    unsigned short expected(double pulse)
+    {
+        unsigned short ticks = static_cast<unsigned short>(pulse * 2 + 0.5);
+        return static_cast<unsigned short>(ticks / 2 * (0.0343 / 2));
+    }
+
+    /**
+     * @brief Wait for the Timer1 count, to place an echo across the end of its period.
+     * @param count Timer1 count (0.5 us ticks).
+     */
+    void waitTimer1(uint16_t count)
+    {
+        while (sim::mcu().getTimer1() >= count) // Next frame
+            sim::mcu().advanceMicros(1);
+        while (sim::mcu().getTimer1() < count)
+            sim::mcu().advanceMicros(1);
+    }
+
+    /**
+     * @brief Ping the group, play the edges polling update() as the main loop does, and compare the
+     * distances stored.
+     * @param name Case name.
+     * @param edges Echo pin changes, in time order.
+     * @param count Number of edges.
+     * @param right Expected right distance.
+     * @param left Expected left distance.
+     * @param timer1 Timer1 count to wait for before the trigger, 0 for none.
+     * @return true Passed.
+     * @return false Failed.
+     */
+    bool check(const char *name, const Edge *edges, unsigned count, unsigned short right, unsigned short left, uint16_t timer1 = 0)
+    {
+        sim::mcu().advanceMicros(Constants::sonarQuietTime * 1000); // After the previous group
+        if (timer1)
+            waitTimer1(timer1);
+        UltrasonicArray::update();
+        if (!PCMSK1)
+        {
+            printf("%-24s FAIL  not pinged\n", name);
+            return false;
+        }
+        double start = sim::mcu().getTime() * 1e6;
+        bool stored{false};
+        for (unsigned i{0}; i < count; ++i)
+        {
+            double now;
+            while ((now = sim::mcu().getTime() * 1e6 - start) < edges[i].time)
+            {
+                stored |= UltrasonicArray::update();
+                sim::mcu().advanceMicros(min(s_waitStep, edges[i].time - now));
+            }
+            drive(edges[i].pins);
+        }
+        if (!stored)
+            stored = waitUpdate(40000);
+        unsigned short gotRight = UltrasonicArray::getDistance(0);
+        unsigned short gotLeft = UltrasonicArray::getDistance(1);
+        bool passed = stored && (gotRight == right) && (gotLeft == left);
+        printf("%-24s %s  right %3u cm (expected %3u)  left %3u cm (expected %3u)\n", name, passed ? "ok  " : "FAIL", gotRight, right, gotLeft, left);
+        return passed;
+    }
+}
+
+int main()
+{
+    Bench bench;
+    sim::mcu().startEpisode(&bench, 60);
+    UltrasonicArray::add(Pins::rightTriggerPin, Pins::rightEchoPin, 0);
+    UltrasonicArray::add(Pins::leftTriggerPin, Pins::leftEchoPin, 0);
+    UltrasonicArray::begin(s_maxDistance, Constants::sonarQuietTime);
+    bool passed{true};
+
+    const Edge separate[]{{450, s_right}, {500, s_right | s_left}, {450 + 1750, s_left}, {500 + 2916, 0}};
+    passed &= check("separate edges", separate, 4, expected(1750), expected(2916));
+
+    const Edge together[]{{450, s_right | s_left}, {450 + 1180, 0}};
+    passed &= check("same interrupt", together, 2, expected(1180), expected(1180));
+
+    const Edge noise[]{{450, s_right}, {600, s_right | s_other}, {700, s_right}, {450 + 2000, 0}};
+    passed &= check("unwatched pin", noise, 4, expected(2000), s_maxDistance);
+
+    passed &= check("no echo", nullptr, 0, s_maxDistance, s_maxDistance);
+
+    const Edge late[]{{450, s_right | s_left}, {450 + 14000, s_left}, {450 + 30000, 0}}; // Left still high after the window
+    passed &= check("echo past the window", late, 3, expected(14000), s_maxDistance);
+
+    const Edge wrap[]{{450, s_right}, {450 + 5840, 0}}; // Across the end of the Timer1 period, the count wraps
+    TIMSK1 |= _BV(OCIE1A); // Servo attached: its interrupt resets TCNT1 every 20 ms frame
+    passed &= check("Timer1 frame end", wrap, 2, expected(5840), s_maxDistance, 40000 - 3000);
+    TIMSK1 &= ~_BV(OCIE1A); // Servo interrupt stopped: TCNT1 overflows
+    passed &= check("Timer1 overflow", wrap, 2, expected(5840), s_maxDistance, 65535 - 3000);
+
+    sim::mcu().endEpisode();
+    return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+/**
+ * @file firmware.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Host versions of the firmware parts bound to the AVR: flight recorder in .noinit and sleep.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include "flightrecorder.h"
+#include "lowpower.h"
+#include "mcu.h"
+
+thread_local FlightRecord FlightRecorder::s_records[FlightRecorder::s_size]{};
+thread_local unsigned char FlightRecorder::s_next{0};
+thread_local FlightRecord FlightRecorder::s_states[FlightRecorder::s_stateSize]{};
+thread_local unsigned char FlightRecorder::s_stateNext{0};
+thread_local unsigned short FlightRecorder::s_valid{0};
+thread_local unsigned char FlightRecorder::s_resetCause{_BV(PORF)}; // Every episode is a power-on
+
+void FlightRecorder::begin()
+{
+    memset(s_records, 0, sizeof(s_records));
+    memset(s_states, 0, sizeof(s_states));
+    s_next = 0;
+    s_stateNext = 0;
+    s_valid = s_magic;
+    log(FlightEvent::RESET, s_resetCause);
+}
+
+void FlightRecorder::dump()
+{
+}
+
+unsigned char FlightRecorder::getResetCause()
+{
+    return s_resetCause;
+}
+
+/**
+ * @brief Sleep until the core tick wakes up the MCU, the control ticks due run meanwhile.
+ */
+void LowPower::idle(unsigned char)
+{
+    sim::mcu().advanceMicros(1000);
+}
\ No newline at end of file
@@ -0,0 +1,252 @@
+/**
+ * @file irtest.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Check of the NEC decoder of Infrared::edge() with synthetic pulse trains, on the virtual MCU.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ *
+ * Usage:
+ *     irtest
+ *
+ * The frames of every key of the remote and their repeat frames are played on the receiver pin as
+ * edges timed with Timer2, as the AVR sees them: 64 us ticks reset at every edge, with a random
+ * prescaler phase, and the overflow flag for gaps over 16 ms. Element times can be jittered. Exit
+ * status 1 if any case fails.
+ */
+
+#include <Arduino.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "constants.h"
+#include "infrared.h"
+#include "mcu.h"
+
+extern "C" void PCINT0_vect(void); // Infrared::edge()
+
+namespace
+{
+    constexpr unsigned s_leadMark{9000}; // NEC element times (us)
+    constexpr unsigned s_leadSpace{4500};
+    constexpr unsigned s_repeatSpace{2250};
+    constexpr unsigned s_bitMark{562};
+    constexpr unsigned s_zeroSpace{562};
+    constexpr unsigned s_oneSpace{1687};
+    constexpr unsigned s_frameGap{40000}; // Idle time before a frame
+    constexpr uint8_t s_pin{digitalPinToBitMask(Pins::IRPin)};
+
+    /**
+     * @brief Hardware without physics, the receiver pin is driven by the cases.
+     */
+    class Bench : public sim::Hardware
+    {
+    public:
+        void update(double) override {}
+        void setMotors(short, short) override {}
+        void setServo(unsigned short) override {}
+        unsigned long trigger() override { return 0; }
+        bool isOnLine(unsigned char) override { return false; }
+        unsigned short readBattery() override { return 0; }
+    };
+
+    /**
+     * @brief Key and its NEC frame, LSB first, as decoded by Infrared::mapKey().
+     */
+    struct KeyCode
+    {
+        Key key;
+        uint32_t code;
+    };
+
+    constexpr KeyCode s_keys[]{
+        {Key::keyOk, 3208707840}, {Key::keyUp, 3108437760}, {Key::keyDown, 3927310080}, {Key::keyLeft, 3141861120},
+        {Key::keyRight, 3158572800}, {Key::key0, 2907897600}, {Key::key1, 3910598400}, {Key::key2, 3860463360},
+        {Key::key3, 4061003520}, {Key::key4, 4077715200}, {Key::key5, 3877175040}, {Key::key6, 2707357440},
+        {Key::key7, 4144561920}, {Key::key8, 3810328320}, {Key::key9, 2774204160}, {Key::keyAsterisk, 3175284480},
+        {Key::keySharp, 3041591040}};
+
+    /**
+     * @brief Element of a pulse train: the receiver output after the edge and the time since the previous one.
+     */
+    struct Element
+    {
+        bool mark;     // Carrier received: receiver output low
+        unsigned time; // Time since the previous edge (us)
+    };
+
+    /**
+     * @brief Receiver pin driven with Timer2 as the decoder reads it.
+     */
+    class Receiver
+    {
+    private:
+        std::mt19937 m_random;
+        double m_jitter; // Maximum relative error of each element
+
+    public:
+        explicit Receiver(unsigned seed) : m_random{seed}, m_jitter{0} {}
+
+        void setJitter(double jitter)
+        {
+            m_jitter = jitter;
+        }
+
+        /**
+         * @brief Play the edges, each one raising the pin change interrupt.
+         * @param train Elements.
+         */
+        void play(const std::vector<Element> &train)
+        {
+            std::uniform_real_distribution<double> error{-m_jitter, m_jitter};
+            std::uniform_real_distribution<double> phase{0, 64};
+            for (const Element &element : train)
+            {
+                double time = element.time * (1 + error(m_random));
+                sim::mcu().advanceMicros(time);
+                double ticks = (time + phase(m_random)) / 64; // Timer2 since the reset at the previous edge
+                TCNT2 = static_cast<uint8_t>(static_cast<unsigned>(ticks) & 0xFF);
+                TIFR2 = (ticks >= 256) ? _BV(TOV2) : 0; // The decoder clears it writing a 1, which the host register keeps
+                PINB = element.mark ? (PINB & ~s_pin) : (PINB | s_pin);
+                PCINT0_vect();
+            }
+        }
+    };
+
+    /**
+     * @brief Pulse train of a frame.
+     * @param code Frame, LSB first.
+     * @param bits Bits sent, fewer than 32 for a truncated frame.
+     * @return std::vector<Element> Elements, ending with the stop bit.
+     */
+    std::vector<Element> frame(uint32_t code, unsigned bits = 32)
+    {
+        std::vector<Element> train{{true, s_frameGap}, {false, s_leadMark}, {true, s_leadSpace}};
+        for (unsigned i{0}; i < bits; ++i)
+        {
+            train.push_back({false, s_bitMark});
+            train.push_back({true, ((code >> i) & 1) ? s_oneSpace : s_zeroSpace});
+        }
+        train.push_back({false, s_bitMark});
+        return train;
+    }
+
+    /**
+     * @brief Pulse train of a repeat frame.
+     * @return std::vector<Element> Elements.
+     */
+    std::vector<Element> repeat()
+    {
+        return {{true, s_frameGap}, {false, s_leadMark}, {true, s_repeatSpace}, {false, s_bitMark}};
+    }
+
+    /**
+     * @brief Decoded events.
+     */
+    struct Tally
+    {
+        unsigned keys{0};     // Expected key
+        unsigned repeats{0};  // Expected key repeated
+        unsigned wrong{0};    // Other keys
+    };
+
+    /**
+     * @brief Drain the decoded events and count them against the expected key.
+     * @param infrared Decoder.
+     * @param key Expected key.
+     * @param tally Counts, updated.
+     */
+    void collect(Infrared &infrared, Key key, Tally &tally)
+    {
+        IREvent event;
+        while (infrared.read(event))
+        {
+            if (event.key != key)
+                ++tally.wrong;
+            else if (event.repeat)
+                ++tally.repeats;
+            else
+                ++tally.keys;
+        }
+    }
+
+    /**
+     * @brief Send every key followed by repeats, and count the events decoded.
+     * @param infrared Decoder.
+     * @param receiver Receiver.
+     * @param rounds Frames of each key.
+     * @param repeats Repeat frames after each frame.
+     * @return Tally Events decoded.
+     */
+    Tally sendKeys(Infrared &infrared, Receiver &receiver, unsigned rounds, unsigned repeats)
+    {
+        Tally tally;
+        for (unsigned round{0}; round < rounds; ++round)
+        {
+            for (const KeyCode &keyCode : s_keys)
+            {
+                receiver.play(frame(keyCode.code));
+                for (unsigned i{0}; i < repeats; ++i)
+                    receiver.play(repeat());
+                collect(infrared, keyCode.key, tally);
+            }
+        }
+        return tally;
+    }
+
+    /**
+     * @brief Print a case result.
+     * @param name Case name.
+     * @param passed Result.
+     * @param tally Events decoded.
+     * @param keys Frames sent.
+     * @param repeats Repeat frames sent.
+     * @return true Passed.
+     * @return false Failed.
+     */
+    bool report(const char *name, bool passed, const Tally &tally, unsigned keys, unsigned repeats)
+    {
+        printf("%-28s %s  keys %4u/%-4u  repeats %4u/%-4u  wrong %u\n", name, passed ? "ok  " : "FAIL", tally.keys, keys, tally.repeats, repeats, tally.wrong);
+        return passed;
+    }
+}
+
+int main()
+{
+    constexpr unsigned keyCount = sizeof(s_keys) / sizeof(s_keys[0]);
+    Bench bench;
+    sim::mcu().startEpisode(&bench, 3600);
+    Infrared infrared{Pins::IRPin};
+    infrared.begin();
+    PINB |= s_pin; // Receiver idle
+    Receiver receiver{1};
+    bool passed{true};
+
+    Tally exact = sendKeys(infrared, receiver, 1, 2);
+    passed &= report("exact timing", (exact.keys == keyCount) && (exact.repeats == 2 * keyCount) && !exact.wrong, exact, keyCount, 2 * keyCount);
+
+    receiver.setJitter(0.2);
+    Tally jitter = sendKeys(infrared, receiver, 12, 2);
+    passed &= report("20 % jitter", (jitter.keys == 12 * keyCount) && (jitter.repeats == 24 * keyCount) && !jitter.wrong, jitter, 12 * keyCount, 24 * keyCount);
+
+    receiver.setJitter(0.4);
+    Tally noisy = sendKeys(infrared, receiver, 12, 2);
+    passed &= report("40 % jitter, no wrong keys", !noisy.wrong, noisy, 12 * keyCount, 24 * keyCount);
+
+    receiver.setJitter(0);
+    Tally truncated;
+    receiver.play(frame(s_keys[0].code));
+    receiver.play(frame(s_keys[1].code, 20)); // Missed, the repeats must not be taken as the first key
+    receiver.play(repeat());
+    collect(infrared, s_keys[0].key, truncated);
+    passed &= report("truncated frame, then repeat", (truncated.keys == 1) && !truncated.repeats && !truncated.wrong, truncated, 1, 0);
+
+    Tally corrupted;
+    receiver.play(frame(s_keys[0].code ^ 0x00010000UL)); // Command and its inverse differ
+    receiver.play(repeat());
+    collect(infrared, s_keys[0].key, corrupted);
+    passed &= report("bad command inverse", !corrupted.keys && !corrupted.repeats && !corrupted.wrong, corrupted, 0, 0);
+
+    sim::mcu().endEpisode();
+    return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/**
+ * @file localize.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Build step of the simulator: copy a firmware file with its static data made thread_local,
+ * so that each worker thread runs its own robot.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    /**
+     * @brief Rewrite the static members of the firmware: "static T s_name;" declarations and
+     * "T Class::s_name" definitions. Constants are kept, they are not written.
+     * @param text File content.
+     * @return std::string Localized content.
+     */
+    std::string localize(std::string text)
+    {
+        static const std::regex declaration{R"(\n([ \t]+)static (volatile )?([A-Za-z_][A-Za-z0-9_:<>, ]*[ *])(s_[A-Za-z0-9_]+(\[[^\]\n]*\])?;))"};
+        static const std::regex definition{R"(\n((volatile )?[A-Za-z_][A-Za-z0-9_:<>, ]*[ *])([A-Za-z_][A-Za-z0-9_]*::s_[A-Za-z0-9_]+))"};
+        static const std::regex naked{R"(__attribute__\(\(naked[^;]*\)\))"};
+        text = std::regex_replace(text, declaration, "\n$1static thread_local $2$3$4");
+        text = std::regex_replace(text, std::regex{"static thread_local const "}, "static const ");
+        text = std::regex_replace(text, std::regex{R"(static void \(\*s_)"}, "static thread_local void (*s_");
+        text = std::regex_replace(text, definition, "\nthread_local $1$3");
+        text = std::regex_replace(text, std::regex{"\nthread_local const "}, "\nconst ");
+        text = std::regex_replace(text, std::regex{R"(\nvoid \(\*([A-Za-z_][A-Za-z0-9_]*)::s_)"}, "\nthread_local void (*$1::s_");
+        return std::regex_replace(text, naked, "");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: localize <input> <output>\n";
+        return 2;
+    }
+    std::ifstream input{argv[1], std::ios::binary};
+    if (!input)
+    {
+        std::cerr << "localize: can not read " << argv[1] << '\n';
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << '\n' << input.rdbuf(); // Declarations at the first line too
+    std::string text = localize(buffer.str()).substr(1);
+    std::string name{argv[1]};
+    std::ofstream output{argv[2], std::ios::binary};
+    output << "#line 1 \"" << name << "\"\n" << text;
+    return output ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+/**
+ * @file main.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Batch scenario runner: the robot control code on a virtual MCU, episodes spread over all the cores.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ *
+ * Usage:
+ *     simulator --episodes 1000 --threads 0 --seed 1 --scenario all --csv episodes.csv
+ *
+ * Each episode is reproducible from the seed and its index, whatever thread runs it.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "pool.h"
+#include "scenario.h"
+
+namespace
+{
+    struct Options
+    {
+        unsigned episodes{300}; // Per scenario
+        unsigned threads{0};    // 0 for all the cores
+        unsigned long long seed{1};
+        std::vector<sim::Scenario> scenarios{sim::Scenario::OBSTACLE, sim::Scenario::LINE, sim::Scenario::PARK, sim::Scenario::DETOUR, sim::Scenario::REPEAT, sim::Scenario::REPEAT_CLEAR, sim::Scenario::DEADEND, sim::Scenario::UTRAP};
+        const char *csv{nullptr};
+    };
+
+    void usage()
+    {
+        fprintf(stderr, "Usage: simulator [--episodes N] [--threads N] [--seed N] [--scenario obstacle|line|park|detour|repeat|repeat-clear|deadend|utrap|all] [--csv FILE]\n");
+    }
+
+    bool parse(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; ++i)
+        {
+            const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if (!value)
+                return false;
+            if (strcmp(argv[i], "--episodes") == 0)
+                options.episodes = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            else if (strcmp(argv[i], "--threads") == 0)
+                options.threads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            else if (strcmp(argv[i], "--seed") == 0)
+                options.seed = strtoull(value, nullptr, 10);
+            else if (strcmp(argv[i], "--csv") == 0)
+                options.csv = value;
+            else if (strcmp(argv[i], "--scenario") == 0)
+            {
+                sim::Scenario scenario;
+                if (strcmp(value, "all") == 0)
+                    options.scenarios = Options{}.scenarios;
+                else if (sim::parseScenario(value, scenario))
+                    options.scenarios = {scenario};
+                else
+                    return false;
+            }
+            else
+                return false;
+            ++i;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Nearest-rank percentile.
+     */
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty())
+            return 0;
+        std::sort(values.begin(), values.end());
+        size_t rank = static_cast<size_t>(p / 100 * values.size() + 0.5);
+        return values[std::min(values.size() - 1, rank ? rank - 1 : 0)];
+    }
+
+    double mean(const std::vector<double> &values)
+    {
+        double sum{0};
+        for (double value : values)
+            sum += value;
+        return values.empty() ? 0 : sum / values.size();
+    }
+
+    void printRow(const char *name, const std::vector<double> &values)
+    {
+        printf("  %-14s%10.2f%10.2f%10.2f\n", name, mean(values), percentile(values, 50), percentile(values, 90));
+    }
+
+    /**
+     * @brief Print each run of the repeated courses: completion, and time and scans of the episodes
+     * which completed every run, so that the runs are compared on the same rooms.
+     */
+    void reportRuns(sim::Scenario scenario, const std::vector<sim::Metrics> &results)
+    {
+        for (size_t run{0};; ++run)
+        {
+            std::vector<double> times, scans;
+            unsigned episodes{0}, completed{0};
+            for (const sim::Metrics &metrics : results)
+            {
+                if ((metrics.scenario != scenario) || (run >= metrics.runs.size()))
+                    continue;
+                ++episodes;
+                if (metrics.runs[run].completed)
+                    ++completed;
+                if (!metrics.completed)
+                    continue;
+                times.push_back(metrics.runs[run].time);
+                scans.push_back(metrics.runs[run].scans);
+            }
+            if (episodes == 0)
+                return;
+            printf("  run %zu: %u started, %u completed\n", run + 1, episodes, completed);
+            printRow("  time (s)", times); // Episodes completed only
+            printRow("  scans", scans);
+        }
+    }
+
+    void report(sim::Scenario scenario, const std::vector<sim::Metrics> &results)
+    {
+        std::vector<double> times, collisions, stops, pings, distances, scans;
+        unsigned episodes{0}, completed{0};
+        for (const sim::Metrics &metrics : results)
+        {
+            if (metrics.scenario != scenario)
+                continue;
+            ++episodes;
+            if (metrics.completed)
+            {
+                ++completed;
+                times.push_back(metrics.time);
+            }
+            collisions.push_back(metrics.collisions);
+            stops.push_back(metrics.stops);
+            pings.push_back(metrics.pings);
+            distances.push_back(metrics.distance);
+            scans.push_back(metrics.scans);
+        }
+        printf("%s: %u episodes, %u completed (%.1f %%)\n", sim::getName(scenario), episodes, completed, episodes ? 100.0 * completed / episodes : 0);
+        printf("  %-14s%10s%10s%10s\n", "", "mean", "p50", "p90");
+        printRow("time (s)", times); // Completed only
+        printRow("collisions", collisions);
+        printRow("stops", stops);
+        printRow("pings", pings);
+        printRow("distance (cm)", distances);
+        printRow("scans", scans);
+        reportRuns(scenario, results);
+    }
+
+    bool writeCsv(const char *path, const std::vector<sim::Metrics> &results)
+    {
+        FILE *file = fopen(path, "w");
+        if (!file)
+            return false;
+        fprintf(file, "scenario,episode,completed,time,collisions,stops,pings,distance,scans\n");
+        for (const sim::Metrics &metrics : results)
+            fprintf(file, "%s,%u,%d,%.3f,%u,%u,%u,%.1f,%u\n", sim::getName(metrics.scenario), metrics.index, metrics.completed ? 1 : 0,
+                    metrics.time, metrics.collisions, metrics.stops, metrics.pings, metrics.distance, metrics.scans);
+        return fclose(file) == 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<sim::Metrics> results(options.scenarios.size() * options.episodes);
+    sim::Pool pool{threads};
+    auto start = std::chrono::steady_clock::now();
+    pool.run(results.size(), [&](size_t job) {
+        sim::Scenario scenario = options.scenarios[job / options.episodes];
+        results[job] = sim::runEpisode(scenario, static_cast<unsigned>(job % options.episodes), options.seed);
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double simulated{0};
+    for (const sim::Metrics &metrics : results)
+        simulated += metrics.time;
+    for (sim::Scenario scenario : options.scenarios)
+        report(scenario, results);
+    printf("%zu episodes on %u threads (%zu stolen) in %.2f s: %.1f episodes/s, %.0f simulated s per s\n", results.size(), threads,
+           pool.getSteals(), wall, results.size() / wall, simulated / wall);
+    if (options.csv && !writeCsv(options.csv, results))
+    {
+        fprintf(stderr, "simulator: can not write %s\n", options.csv);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,494 @@
+/**
+ * @file mcu.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Virtual ATmega328P of a simulator thread: virtual time, Timer0/Timer1, interrupts, pins and EEPROM.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Servo.h>
+#include <cstring>
+#include <limits>
+#include "constants.h"
+#include "mcu.h"
+
+extern "C" void TIMER1_COMPB_vect(void); // ControlTick
+
+// Registers of the thread MCU, with the values left by the Arduino core init()
+thread_local volatile uint8_t TCCR0A{_BV(WGM01) | _BV(WGM00)}; // Fast PWM
+thread_local volatile uint8_t TCCR0B{_BV(CS01) | _BV(CS00)};   // Prescaler 64
+thread_local volatile uint8_t TIMSK0{1};
+thread_local volatile uint8_t TCCR1A{0};
+thread_local volatile uint8_t TCCR1B{0};
+thread_local volatile uint8_t TIMSK1{0};
+thread_local volatile uint8_t TIFR1{0};
+thread_local volatile uint16_t OCR1A{0};
+thread_local volatile uint16_t OCR1B{0};
+thread_local volatile uint8_t TCCR2A{0};
+thread_local volatile uint8_t TCCR2B{0};
+thread_local volatile uint8_t TIMSK2{0};
+thread_local volatile uint8_t TIFR2{0};
+thread_local volatile uint8_t TCNT2{0};
+thread_local volatile uint8_t PCICR{0};
+thread_local volatile uint8_t PCIFR{0};
+thread_local volatile uint8_t PCMSK0{0};
+thread_local volatile uint8_t PCMSK1{0};
+thread_local volatile uint8_t PCMSK2{0};
+thread_local volatile uint8_t PINB{0xFF};
+thread_local volatile uint8_t PINC{0};
+thread_local volatile uint8_t PIND{0};
+thread_local volatile uint8_t MCUSR{0};
+thread_local volatile uint8_t SREG{0x80};
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+namespace sim
+{
+    namespace
+    {
+        // Approximate duration of the core calls (us)
+        constexpr double s_pinCost{4};
+        constexpr double s_analogWriteCost{6};
+        constexpr double s_analogReadCost{112};
+        constexpr double s_timeCost{2};
+        constexpr double s_interruptCost{3};
+        constexpr double s_echoDelay{450};    // Trigger to echo start of the HC-SR04
+        constexpr unsigned long s_noEcho{38000}; // Echo pulse of the HC-SR04 without obstacle
+    }
+
+    /**
+     * @brief Return the MCU of the calling thread.
+     * @return Mcu& MCU.
+     */
+    Mcu &mcu()
+    {
+        thread_local Mcu t_mcu;
+        return t_mcu;
+    }
+
+    /**
+     * @brief Timer1 count, read by the firmware as TCNT1.
+     * @return uint16_t Count.
+     */
+    uint16_t timer1Count()
+    {
+        return mcu().getTimer1();
+    }
+
+    /**
+     * @brief EEPROM byte of the thread MCU.
+     * @param address Address, wrapped to the size.
+     * @return uint8_t* Byte.
+     */
+    uint8_t *eeprom(int address)
+    {
+        return mcu().eeprom(address);
+    }
+
+    /**
+     * @brief Construct a new Mcu::Mcu object.
+     */
+    Mcu::Mcu()
+        : m_time{0}, m_start{0}, m_deadline{std::numeric_limits<uint64_t>::max()}, m_hardware{nullptr}, m_inInterrupt{false}, m_tickPending{false},
+          m_timer0A{0}, m_timer0B{0}, m_coreBase{0}, m_coreBaseTime{0}, m_coreRate{1}, m_outputs{}, m_pwm{}, m_echo{0}
+    {
+        memset(m_eeprom, 0xFF, sizeof(m_eeprom));
+    }
+
+    /**
+     * @brief Start an episode on new hardware. The time keeps running from the previous episodes, as the
+     * firmware statics only see time going forward, aligned to a second so the Timer1 phase is always the same.
+     * @param hardware Hardware of the episode.
+     * @param duration Virtual time available (s).
+     */
+    void Mcu::startEpisode(Hardware *hardware, double duration)
+    {
+        constexpr uint64_t second{2000000};
+        m_time = (m_time / second + 1) * second;
+        m_start = m_time;
+        m_deadline = m_time + static_cast<uint64_t>(duration * second);
+        m_hardware = hardware;
+        m_tickPending = false;
+        memset(m_outputs, 0, sizeof(m_outputs));
+        memset(m_pwm, 0, sizeof(m_pwm));
+        memset(m_eeprom, 0xFF, sizeof(m_eeprom)); // Erased: default parameters, no route
+        m_echo = 0;
+        SREG = 0x80;
+        m_hardware->update(getTime());
+    }
+
+    /**
+     * @brief Detach the hardware of the episode.
+     */
+    void Mcu::endEpisode()
+    {
+        m_hardware = nullptr;
+        m_deadline = std::numeric_limits<uint64_t>::max();
+    }
+
+    /**
+     * @brief Time of the next Timer1 compare B interrupt.
+     * @return uint64_t Virtual time, the maximum if disabled.
+     */
+    uint64_t Mcu::nextCompare() const
+    {
+        uint32_t period = timer1Period();
+        if (!(TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) || !(TIMSK1 & _BV(OCIE1B)) || (OCR1B >= period))
+            return std::numeric_limits<uint64_t>::max();
+        uint64_t delta = (OCR1B + period - m_time % period) % period;
+        return m_time + (delta ? delta : period);
+    }
+
+    /**
+     * @brief Timer1 period: the servo frame while the Servo library interrupt resets the count, 16 bits otherwise.
+     * @return uint32_t Period (0.5 us ticks).
+     */
+    uint32_t Mcu::timer1Period() const
+    {
+        return (TIMSK1 & _BV(OCIE1A)) ? s_frame : s_wrap;
+    }
+
+    /**
+     * @brief Run the control tick interrupt, with the interrupts disabled as on the AVR.
+     */
+    void Mcu::runTick()
+    {
+        uint8_t sreg = SREG;
+        m_inInterrupt = true;
+        SREG = sreg & ~0x80;
+        advanceMicros(s_interruptCost);
+        TIMER1_COMPB_vect();
+        SREG = sreg;
+        m_inInterrupt = false;
+    }
+
+    /**
+     * @brief Let the virtual time pass, running the interrupts due.
+     * @param ticks Time (0.5 us ticks).
+     */
+    void Mcu::advance(uint64_t ticks)
+    {
+        uint64_t target = m_time + ticks;
+        while (!m_inInterrupt)
+        {
+            if (m_tickPending && (SREG & 0x80))
+            {
+                m_tickPending = false;
+                runTick();
+                continue;
+            }
+            uint64_t next = nextCompare();
+            if (next > target)
+                break;
+            m_time = next;
+            if (SREG & 0x80)
+                runTick();
+            else
+                m_tickPending = true;
+        }
+        if (m_time < target)
+            m_time = target;
+        if (!m_inInterrupt && (m_time > m_deadline))
+            throw Timeout{};
+    }
+
+    /**
+     * @brief Let the virtual time pass.
+     * @param us Time (us).
+     */
+    void Mcu::advanceMicros(double us)
+    {
+        advance(static_cast<uint64_t>(us * 2 + 0.5));
+    }
+
+    /**
+     * @brief Get the virtual time from the episode start, the time of the hardware.
+     * @return double Time (s).
+     */
+    double Mcu::getTime() const
+    {
+        return (m_time - m_start) * 0.5e-6;
+    }
+
+    /**
+     * @brief Get the Timer1 count, reset every servo frame while the Servo library interrupt runs.
+     * @return uint16_t Count (0.5 us ticks).
+     */
+    uint16_t Mcu::getTimer1() const
+    {
+        if (!(TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))))
+            return 0;
+        return m_time % timer1Period();
+    }
+
+    /**
+     * @brief Rebase the core time when the Timer0 prescaler or mode changes.
+     */
+    void Mcu::updateCoreRate()
+    {
+        if ((TCCR0A == m_timer0A) && (TCCR0B == m_timer0B))
+            return;
+        m_coreBase += (m_time - m_coreBaseTime) * 0.5 * m_coreRate;
+        m_coreBaseTime = m_time;
+        m_timer0A = TCCR0A;
+        m_timer0B = TCCR0B;
+        static constexpr double prescalers[8]{0, 1, 8, 64, 256, 1024, 0, 0};
+        double prescaler = prescalers[m_timer0B & 0x07];
+        m_coreRate = (prescaler > 0) ? 64 / prescaler : 0;
+        if ((m_timer0A & (_BV(WGM01) | _BV(WGM00))) == _BV(WGM00)) // Phase correct: 510 ticks per overflow
+            m_coreRate *= 256.0 / 510;
+    }
+
+    /**
+     * @brief Get the core micros(), which depends on the Timer0 configuration as on the robot.
+     * @return uint64_t Core time (us), micros() and millis() wrap it.
+     */
+    uint64_t Mcu::getCoreMicros()
+    {
+        updateCoreRate();
+        return static_cast<uint64_t>(m_coreBase + (m_time - m_coreBaseTime) * 0.5 * m_coreRate);
+    }
+
+    /**
+     * @brief Send the motor driver inputs to the hardware.
+     */
+    void Mcu::updateMotors()
+    {
+        if (!m_hardware)
+            return;
+        short right = m_pwm[Pins::motorsEnA];
+        if (m_outputs[Pins::motorsIn1] == m_outputs[Pins::motorsIn2])
+            right = 0; // Brake
+        else if (m_outputs[Pins::motorsIn2])
+            right = -right;
+        short left = m_pwm[Pins::motorsEnB];
+        if (m_outputs[Pins::motorsIn3] == m_outputs[Pins::motorsIn4])
+            left = 0;
+        else if (m_outputs[Pins::motorsIn3])
+            left = -left;
+        m_hardware->update(getTime());
+        m_hardware->setMotors(left, right);
+    }
+
+    void Mcu::pinMode(uint8_t, uint8_t)
+    {
+        advanceMicros(s_pinCost);
+    }
+
+    void Mcu::digitalWrite(uint8_t pin, uint8_t value)
+    {
+        advanceMicros(s_pinCost);
+        if (pin >= sizeof(m_outputs))
+            return;
+        m_outputs[pin] = value ? HIGH : LOW;
+        if ((pin == Pins::motorsEnA) || (pin == Pins::motorsEnB))
+            m_pwm[pin] = value ? 255 : 0;
+        if ((pin == Pins::triggerPin) && value && m_hardware)
+        {
+            m_hardware->update(getTime());
+            m_echo = m_hardware->trigger();
+        }
+        if ((pin == Pins::motorsEnA) || (pin == Pins::motorsEnB) || (pin == Pins::motorsIn1) || (pin == Pins::motorsIn2) ||
+            (pin == Pins::motorsIn3) || (pin == Pins::motorsIn4))
+            updateMotors();
+    }
+
+    int Mcu::digitalRead(uint8_t pin)
+    {
+        advanceMicros(s_pinCost);
+        if (m_hardware && ((pin == Pins::ltLeftPin) || (pin == Pins::ltMidPin) || (pin == Pins::ltRightPin)))
+        {
+            m_hardware->update(getTime());
+            unsigned char sensor = (pin == Pins::ltLeftPin) ? 0 : ((pin == Pins::ltMidPin) ? 1 : 2);
+            return m_hardware->isOnLine(sensor) ? LOW : HIGH; // Dark line
+        }
+        if (pin == Pins::IRPin)
+            return HIGH; // Receiver idle
+        return (pin < sizeof(m_outputs)) ? m_outputs[pin] : LOW;
+    }
+
+    void Mcu::analogWrite(uint8_t pin, int value)
+    {
+        advanceMicros(s_analogWriteCost);
+        if (pin >= sizeof(m_pwm))
+            return;
+        m_pwm[pin] = constrain(value, 0, 255);
+        m_outputs[pin] = value > 0;
+        if ((pin == Pins::motorsEnA) || (pin == Pins::motorsEnB))
+            updateMotors();
+    }
+
+    int Mcu::analogRead(uint8_t pin)
+    {
+        advanceMicros(s_analogReadCost);
+        if (m_hardware && (pin == Pins::batteryPin))
+            return m_hardware->readBattery();
+        return 0;
+    }
+
+    /**
+     * @brief Wait for the echo of the last trigger. Only the servo sonar is simulated.
+     * @param pin Echo pin.
+     * @param timeout Maximum wait (us).
+     * @return unsigned long Echo pulse (us), 0 if it did not end in time.
+     */
+    unsigned long Mcu::pulseIn(uint8_t pin, uint8_t, unsigned long timeout)
+    {
+        unsigned long echo = (pin == Pins::echoPin) ? m_echo : 0;
+        m_echo = 0;
+        unsigned long pulse = echo ? echo : s_noEcho;
+        if (s_echoDelay + pulse > timeout)
+        {
+            advanceMicros(timeout);
+            return 0;
+        }
+        advanceMicros(s_echoDelay + pulse);
+        return pulse;
+    }
+
+    /**
+     * @brief Servo pulse from the Servo library.
+     * @param pulse Pulse width (us).
+     */
+    void Mcu::servo(unsigned short pulse)
+    {
+        if (!m_hardware)
+            return;
+        m_hardware->update(getTime());
+        m_hardware->setServo(pulse);
+    }
+
+    uint8_t *Mcu::eeprom(int address)
+    {
+        return &m_eeprom[static_cast<unsigned int>(address) % sizeof(m_eeprom)];
+    }
+}
+
+// Arduino core on the thread MCU
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    sim::mcu().pinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    sim::mcu().digitalWrite(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+    return sim::mcu().digitalRead(pin);
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+    sim::mcu().analogWrite(pin, value);
+}
+
+int analogRead(uint8_t pin)
+{
+    return sim::mcu().analogRead(pin);
+}
+
+void analogReference(uint8_t)
+{
+}
+
+unsigned long millis()
+{
+    sim::mcu().advanceMicros(sim::s_timeCost);
+    return static_cast<uint32_t>(sim::mcu().getCoreMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    sim::mcu().advanceMicros(sim::s_timeCost);
+    return static_cast<uint32_t>(sim::mcu().getCoreMicros());
+}
+
+void delay(unsigned long ms)
+{
+    unsigned long start = micros();
+    while ((micros() - start) < ms * 1000)
+        sim::mcu().advanceMicros(100);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    sim::mcu().advanceMicros(us);
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
+{
+    return sim::mcu().pulseIn(pin, state, timeout);
+}
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh)
+{
+    return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+// Servo library on the thread MCU
+
+Servo::Servo()
+    : m_pin{-1}, m_min{MIN_PULSE_WIDTH}, m_max{MAX_PULSE_WIDTH}, m_pulse{1500}
+{
+}
+
+uint8_t Servo::attach(int pin)
+{
+    return attach(pin, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH);
+}
+
+uint8_t Servo::attach(int pin, int min, int max)
+{
+    if (!(TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10)))) // Timer1 started: normal mode, prescaler 8
+    {
+        TCCR1A = 0;
+        TCCR1B = _BV(CS11);
+    }
+    TIMSK1 |= _BV(OCIE1A); // Frame interrupt, kept after detach() as in the AVR library
+    m_pin = pin;
+    m_min = min;
+    m_max = max;
+    return 0;
+}
+
+void Servo::detach()
+{
+    m_pin = -1;
+}
+
+void Servo::write(int value)
+{
+    if (value < MIN_PULSE_WIDTH) // Angle
+        value = map(constrain(value, 0, 180), 0, 180, m_min, m_max);
+    writeMicroseconds(value);
+}
+
+void Servo::writeMicroseconds(int value)
+{
+    m_pulse = constrain(value, m_min, m_max);
+    if (m_pin >= 0)
+        sim::mcu().servo(m_pulse);
+}
+
+int Servo::read()
+{
+    return map(readMicroseconds() + 1, m_min, m_max, 0, 180);
+}
+
+int Servo::readMicroseconds()
+{
+    return m_pulse;
+}
+
+bool Servo::attached()
+{
+    return m_pin >= 0;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**
+ * @file mcu.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Virtual ATmega328P of a simulator thread: virtual time, Timer0/Timer1, interrupts, pins and EEPROM.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_MCU_H
+#define SIM_MCU_H
+
+#include <cstdint>
+
+namespace sim
+{
+    /**
+     * @brief Robot hardware seen from the pins: motors, servo, sonar, line sensors and battery.
+     */
+    class Hardware
+    {
+    public:
+        virtual ~Hardware() = default;
+        virtual void update(double time) = 0;                  // Physics until the time (s)
+        virtual void setMotors(short left, short right) = 0;   // Signed duty cycles
+        virtual void setServo(unsigned short pulse) = 0;       // Pulse width (us)
+        virtual unsigned long trigger() = 0;                    // Sonar pinged, echo pulse (us), 0 for none
+        virtual bool isOnLine(unsigned char sensor) = 0;       // 0 left, 1 middle, 2 right
+        virtual unsigned short readBattery() = 0;              // ADC count
+    };
+
+    /**
+     * @brief Thrown out of the firmware when the episode runs out of virtual time, also from blocking loops.
+     */
+    struct Timeout
+    {
+    };
+
+    class Mcu
+    {
+    private:
+        static constexpr uint32_t s_frame{40000}; // Timer1 period set by the Servo library (0.5 us ticks)
+        static constexpr uint32_t s_wrap{65536};  // Timer1 period without the Servo library interrupt
+        uint64_t m_time;          // Virtual time (0.5 us ticks)
+        uint64_t m_start;         // Episode start
+        uint64_t m_deadline;      // Episode end, Timeout after it
+        Hardware *m_hardware;
+        bool m_inInterrupt;
+        bool m_tickPending;       // Compare match while the interrupts were disabled
+        uint8_t m_timer0A, m_timer0B; // Timer0 configuration of the core time scale
+        double m_coreBase;        // Core time at the last Timer0 change (us)
+        uint64_t m_coreBaseTime;  // Virtual time of the last Timer0 change
+        double m_coreRate;        // Core time per real time
+        uint8_t m_outputs[20];    // Digital outputs
+        uint8_t m_pwm[20];        // analogWrite() duty cycles
+        unsigned long m_echo;     // Echo pulse of the last trigger (us)
+        uint8_t m_eeprom[1024];
+
+        uint64_t nextCompare() const;
+        uint32_t timer1Period() const;
+        void runTick();
+        void updateCoreRate();
+        void updateMotors();
+
+    public:
+        Mcu();
+        void startEpisode(Hardware *hardware, double duration);
+        void endEpisode();
+        void advance(uint64_t ticks);
+        void advanceMicros(double us);
+        double getTime() const;
+        uint16_t getTimer1() const;
+        uint64_t getCoreMicros();
+
+        void pinMode(uint8_t pin, uint8_t mode);
+        void digitalWrite(uint8_t pin, uint8_t value);
+        int digitalRead(uint8_t pin);
+        void analogWrite(uint8_t pin, int value);
+        int analogRead(uint8_t pin);
+        unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
+        void servo(unsigned short pulse);
+        uint8_t *eeprom(int address);
+    };
+
+    Mcu &mcu();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+/**
+ * @file Arduino.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Host replacement of the Arduino core for the simulator, backed by the virtual MCU of the thread.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "avr/interrupt.h"
+#include "avr/io.h"
+#include "avr/pgmspace.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define DEFAULT 1
+#define INTERNAL 3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bit(b) (1UL << (b))
+#define bitRead(value, b) (((value) >> (b)) & 0x01)
+#define F(string) (string)
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+// Port B: pins 8-13, port C: A0-A5, port D: pins 0-7
+#define digitalPinToPort(p) (((p) < 8) ? 4 : (((p) < 14) ? 2 : 3))
+#define digitalPinToBitMask(p) (1 << (((p) < 8) ? (p) : (((p) < 14) ? (p) - 8 : (p) - 14)))
+#define portInputRegister(port) (((port) == 2) ? &PINB : (((port) == 3) ? &PINC : &PIND))
+#define digitalPinToPCICR(p) (&PCICR)
+#define digitalPinToPCICRbit(p) (((p) < 8) ? PCIE2 : (((p) < 14) ? PCIE0 : PCIE1))
+#define digitalPinToPCMSK(p) (((p) < 8) ? &PCMSK2 : (((p) < 14) ? &PCMSK0 : &PCMSK1))
+#define digitalPinToPCMSKbit(p) (((p) < 8) ? (p) : (((p) < 14) ? (p) - 8 : (p) - 14))
+
+/**
+ * @brief Templates instead of the Arduino macros, which would break the standard headers.
+ */
+template <typename T, typename U>
+inline auto min(const T &a, const U &b) -> decltype(a < b ? a : b)
+{
+    return (a < b) ? a : b;
+}
+
+template <typename T, typename U>
+inline auto max(const T &a, const U &b) -> decltype(a > b ? a : b)
+{
+    return (a > b) ? a : b;
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);
+
+/**
+ * @brief Serial port which only takes the time of the calls, the output is dropped.
+ */
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    int availableForWrite() { return 63; }
+    void flush() {}
+    explicit operator bool() { return true; }
+    size_t write(uint8_t) { return 1; }
+    template <typename T>
+    size_t print(const T &) { return 1; }
+    template <typename T>
+    size_t print(const T &, int) { return 1; }
+    template <typename T>
+    size_t println(const T &) { return 1; }
+    template <typename T>
+    size_t println(const T &, int) { return 1; }
+    size_t println() { return 1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
\ No newline at end of file
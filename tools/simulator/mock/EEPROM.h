@@ -0,0 +1,45 @@
+/**
+ * @file EEPROM.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief EEPROM of the virtual MCU, erased at each episode.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+namespace sim
+{
+    uint8_t *eeprom(int address);
+}
+
+struct EEPROMClass
+{
+    uint8_t read(int address) { return *sim::eeprom(address); }
+    void write(int address, uint8_t value) { *sim::eeprom(address) = value; }
+    void update(int address, uint8_t value) { *sim::eeprom(address) = value; }
+    uint16_t length() { return 1024; }
+
+    template <typename T>
+    T &get(int address, T &value)
+    {
+        memcpy(&value, sim::eeprom(address), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &value)
+    {
+        memcpy(sim::eeprom(address), &value, sizeof(T));
+        return value;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
\ No newline at end of file
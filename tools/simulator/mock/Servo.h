@@ -0,0 +1,38 @@
+/**
+ * @file Servo.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Servo library of the virtual MCU: the pulse goes to the simulated servo, Timer1 runs as on the robot.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_SERVO_H
+#define SIM_SERVO_H
+
+#include <stdint.h>
+
+#define MIN_PULSE_WIDTH 544
+#define MAX_PULSE_WIDTH 2400
+#define REFRESH_INTERVAL 20000
+
+class Servo
+{
+private:
+    int m_pin;
+    int m_min, m_max; // Pulse of 0 and 180 deg (us)
+    int m_pulse;      // Pulse commanded (us)
+
+public:
+    Servo();
+    uint8_t attach(int pin);
+    uint8_t attach(int pin, int min, int max);
+    void detach();
+    void write(int value);
+    void writeMicroseconds(int value);
+    int read();
+    int readMicroseconds();
+    bool attached();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+/**
+ * @file interrupt.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Interrupt vectors as C functions called by the virtual MCU, and the global interrupt flag in SREG.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include "io.h"
+
+#define ISR(vector, ...)           \
+    extern "C" void vector(void); \
+    extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector)    \
+    extern "C" void vector(void); \
+    extern "C" void vector(void) {}
+
+inline void cli()
+{
+    SREG &= ~0x80;
+}
+
+inline void sei()
+{
+    SREG |= 0x80;
+}
+
+#endif
\ No newline at end of file
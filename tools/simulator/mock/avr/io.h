@@ -0,0 +1,67 @@
+/**
+ * @file io.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief ATmega328P registers used by the firmware, per thread, and their bit numbers.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+#define SIM_REG8(name) extern thread_local volatile uint8_t name;
+#define SIM_REG16(name) extern thread_local volatile uint16_t name;
+
+SIM_REG8(TCCR0A) SIM_REG8(TCCR0B) SIM_REG8(TIMSK0)
+SIM_REG8(TCCR1A) SIM_REG8(TCCR1B) SIM_REG8(TIMSK1) SIM_REG8(TIFR1) SIM_REG16(OCR1A) SIM_REG16(OCR1B)
+SIM_REG8(TCCR2A) SIM_REG8(TCCR2B) SIM_REG8(TIMSK2) SIM_REG8(TIFR2) SIM_REG8(TCNT2)
+SIM_REG8(PCICR) SIM_REG8(PCIFR) SIM_REG8(PCMSK0) SIM_REG8(PCMSK1) SIM_REG8(PCMSK2)
+SIM_REG8(PINB) SIM_REG8(PINC) SIM_REG8(PIND)
+SIM_REG8(MCUSR) SIM_REG8(SREG)
+
+#undef SIM_REG8
+#undef SIM_REG16
+
+namespace sim
+{
+    uint16_t timer1Count();
+}
+#define TCNT1 (sim::timer1Count()) // Counts the virtual time, read only
+
+#define _BV(b) (1 << (b))
+
+// TCCR0A, TCCR0B
+#define WGM00 0
+#define WGM01 1
+#define CS00 0
+#define CS01 1
+#define CS02 2
+// TCCR1B, TIMSK1, TIFR1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCF1B 2
+// TCCR2B, TIFR2
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define TOV2 0
+// PCICR, PCIFR
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+// MCUSR
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+#endif
\ No newline at end of file
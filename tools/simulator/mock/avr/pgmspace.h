@@ -0,0 +1,22 @@
+/**
+ * @file pgmspace.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Program memory is plain memory on the host.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(string) (string)
+#define memcpy_P memcpy
+#define pgm_read_byte(address) (*reinterpret_cast<const uint8_t *>(address))
+#define pgm_read_word(address) (*reinterpret_cast<const uint16_t *>(address))
+
+#endif
\ No newline at end of file
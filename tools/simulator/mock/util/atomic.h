@@ -0,0 +1,35 @@
+/**
+ * @file atomic.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief ATOMIC_BLOCK with the semantics of avr-libc on the SREG of the virtual MCU.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_UTIL_ATOMIC_H
+#define SIM_UTIL_ATOMIC_H
+
+#include "../avr/interrupt.h"
+
+inline uint8_t simCliReturn()
+{
+    cli();
+    return 1;
+}
+
+inline void simRestoreState(const uint8_t *sreg)
+{
+    SREG = *sreg;
+}
+
+inline void simForceOn(const uint8_t *)
+{
+    sei();
+}
+
+#define ATOMIC_BLOCK(type) for (type, simToDo = simCliReturn(); simToDo; simToDo = 0)
+#define ATOMIC_RESTORESTATE uint8_t simSreg __attribute__((__cleanup__(simRestoreState))) = SREG
+#define ATOMIC_FORCEON uint8_t simSreg __attribute__((__cleanup__(simForceOn))) = 0
+
+#endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+/**
+ * @file crc16.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief CRC-16 of avr-libc (polynomial 0xA001), so the EEPROM images match the robot.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_UTIL_CRC16_H
+#define SIM_UTIL_CRC16_H
+
+#include <stdint.h>
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; ++i)
+        crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+    return crc;
+}
+
+#endif
\ No newline at end of file
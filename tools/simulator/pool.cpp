@@ -0,0 +1,121 @@
+/**
+ * @file pool.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Work-stealing thread pool running a batch of independent jobs.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <thread>
+#include "pool.h"
+
+namespace sim
+{
+    /**
+     * @brief Construct a new Pool::Pool object.
+     * @param threads Worker threads, at least one.
+     */
+    Pool::Pool(size_t threads)
+        : m_steals{0}
+    {
+        for (size_t i{0}; i < (threads ? threads : 1); ++i)
+            m_queues.emplace_back(new Queue);
+    }
+
+    size_t Pool::getThreads() const
+    {
+        return m_queues.size();
+    }
+
+    /**
+     * @brief Get the jobs taken from another worker in the last run.
+     * @return size_t Steals.
+     */
+    size_t Pool::getSteals() const
+    {
+        return m_steals;
+    }
+
+    bool Pool::pop(size_t worker, size_t &job)
+    {
+        Queue &queue = *m_queues[worker];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        if (queue.jobs.empty())
+            return false;
+        job = queue.jobs.back();
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest job of another worker, starting from a random one.
+     * @param worker Thief.
+     * @param job Job stolen.
+     * @param random State of the victim choice.
+     * @return true Job stolen, false if every queue is empty: the batch is finishing.
+     */
+    bool Pool::steal(size_t worker, size_t &job, unsigned &random)
+    {
+        size_t count = m_queues.size();
+        random = random * 1103515245 + 12345;
+        size_t first = (random >> 16) % count;
+        for (size_t i{0}; i < count; ++i)
+        {
+            size_t victim = (first + i) % count;
+            if (victim == worker)
+                continue;
+            Queue &queue = *m_queues[victim];
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            if (queue.jobs.empty())
+                continue;
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void Pool::work(size_t worker, const std::function<void(size_t)> &function)
+    {
+        unsigned random = static_cast<unsigned>(worker) + 1;
+        size_t steals{0};
+        size_t job;
+        for (;;)
+        {
+            if (pop(worker, job))
+                function(job);
+            else if (steal(worker, job, random))
+            {
+                ++steals;
+                function(job);
+            }
+            else
+                break; // No job is added during a run
+        }
+        std::lock_guard<std::mutex> lock{m_stealsMutex};
+        m_steals += steals;
+    }
+
+    /**
+     * @brief Run the jobs 0 to jobs - 1, dealt in blocks to the workers, and wait for all of them.
+     * @param jobs Number of jobs.
+     * @param function Job, called from the worker threads. It must not throw.
+     */
+    void Pool::run(size_t jobs, const std::function<void(size_t)> &function)
+    {
+        size_t count = m_queues.size();
+        m_steals = 0;
+        for (size_t worker{0}; worker < count; ++worker) // Neighbouring jobs to the same worker
+        {
+            std::lock_guard<std::mutex> lock{m_queues[worker]->mutex};
+            for (size_t job{jobs * worker / count}; job < jobs * (worker + 1) / count; ++job)
+                m_queues[worker]->jobs.push_front(job); // Popped from the back in order
+        }
+        std::vector<std::thread> threads;
+        for (size_t worker{0}; worker < count; ++worker)
+            threads.emplace_back(&Pool::work, this, worker, std::cref(function));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+/**
+ * @file pool.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Work-stealing thread pool running a batch of independent jobs.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_POOL_H
+#define SIM_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sim
+{
+    /**
+     * @brief Each worker takes its jobs from the back of its own queue and, once empty, steals from the
+     * front of the others, so the long episodes do not leave the rest of the cores idle.
+     */
+    class Pool
+    {
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<size_t> jobs;
+        };
+
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        size_t m_steals;
+        std::mutex m_stealsMutex;
+
+        bool pop(size_t worker, size_t &job);
+        bool steal(size_t worker, size_t &job, unsigned &random);
+        void work(size_t worker, const std::function<void(size_t)> &job);
+
+    public:
+        explicit Pool(size_t threads);
+        void run(size_t jobs, const std::function<void(size_t)> &job);
+        size_t getThreads() const;
+        size_t getSteals() const;
+    };
+}
+
+#endif
\ No newline at end of file
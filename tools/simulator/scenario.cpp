@@ -0,0 +1,390 @@
+/**
+ * @file scenario.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Simulated episodes: random surroundings for a robot mode and the metrics of the run.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include "clock.h"
+#include "constants.h"
+#include "controltick.h"
+#include "mcu.h"
+#include "robot.h"
+#include "scenario.h"
+#include "world.h"
+
+namespace sim
+{
+    namespace
+    {
+        constexpr double s_pi{3.14159265358979323846};
+        constexpr double s_setupTime{1};        // Virtual time for begin() and the serial delay (s)
+        constexpr double s_loopTime{100};       // Rest of the main loop: Bluetooth, requests (us)
+        constexpr double s_obstacleTime{90};    // Time limits (s)
+        constexpr double s_lineTime{60};
+        constexpr double s_parkTime{30};
+        constexpr double s_detourTime{30};
+        constexpr double s_trapTime{30};
+        constexpr double s_trapEscape{120};     // Distance from the back of the trap to escape (cm)
+        constexpr unsigned s_repeatRuns{3};     // Runs of a repeated course
+        constexpr double s_settleTime{0.5};     // Stopped between the runs (s)
+        constexpr double s_obstacleGoal{600};   // Distance to travel avoiding the obstacles (cm)
+        constexpr double s_lineLost{30};        // Distance from the line giving up the lap (cm)
+        constexpr double s_detourLost{120};     // Same going around the box (cm)
+        constexpr double s_detourRadius{500};   // Radius of the line (cm)
+        constexpr double s_detourBox{60};       // Line length from the robot to the box (cm)
+        constexpr double s_detourSize{16};      // Box side (cm)
+        constexpr double s_detourPast{40};      // Line length past the box to complete (cm)
+        constexpr double s_detourBack{3};       // Distance from the line once past the box (cm)
+        constexpr double s_wall{5};             // Wall thickness (cm)
+
+        /**
+         * @brief Seed of an episode, independent of the thread running it.
+         */
+        uint64_t mix(uint64_t value)
+        {
+            value += 0x9E3779B97F4A7C15ULL; // SplitMix64
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+            return value ^ (value >> 31);
+        }
+
+        double uniform(World &world, double low, double high)
+        {
+            return std::uniform_real_distribution<double>{low, high}(world.random());
+        }
+
+        bool overlaps(const Box &a, const Box &b, double margin)
+        {
+            return (a.x0 < b.x1 + margin) && (b.x0 < a.x1 + margin) && (a.y0 < b.y1 + margin) && (b.y0 < a.y1 + margin);
+        }
+
+        /**
+         * @brief Walled room with boxes around the robot in the middle, sometimes a U-trap in front of it.
+         */
+        void buildRoom(World &world)
+        {
+            double width = uniform(world, 300, 500), height = uniform(world, 250, 400);
+            world.addBox({-s_wall, -s_wall, width + s_wall, 0});
+            world.addBox({-s_wall, height, width + s_wall, height + s_wall});
+            world.addBox({-s_wall, 0, 0, height});
+            world.addBox({width, 0, width + s_wall, height});
+
+            Pose start{width / 2, height / 2, uniform(world, -s_pi, s_pi)};
+            Box clear{start.x - 45, start.y - 45, start.x + 45, start.y + 45};
+            std::vector<Box> placed;
+            if (uniform(world, 0, 1) < 0.25) // U-trap open towards the robot
+            {
+                double axis = std::floor(uniform(world, 0, 4)) * s_pi / 2;
+                start.heading = axis + uniform(world, -0.3, 0.3);
+                double depth = uniform(world, 60, 80), half = uniform(world, 28, 38), side = 50;
+                double c = std::round(std::cos(axis)), s = std::round(std::sin(axis));
+                auto rotated = [&](double along0, double across0, double along1, double across1) {
+                    double x0 = start.x + along0 * c - across0 * s, y0 = start.y + along0 * s + across0 * c;
+                    double x1 = start.x + along1 * c - across1 * s, y1 = start.y + along1 * s + across1 * c;
+                    return Box{std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)};
+                };
+                placed.push_back(rotated(depth, -half - s_wall, depth + s_wall, half + s_wall)); // Back
+                placed.push_back(rotated(depth - side, half, depth, half + s_wall));             // Sides
+                placed.push_back(rotated(depth - side, -half - s_wall, depth, -half));
+            }
+            unsigned count = static_cast<unsigned>(uniform(world, 3, 7));
+            for (unsigned attempt{0}; (attempt < 50) && (count > 0); ++attempt)
+            {
+                double w = uniform(world, 15, 40), h = uniform(world, 15, 40);
+                double x = uniform(world, 20, width - 20 - w), y = uniform(world, 20, height - 20 - h);
+                Box box{x, y, x + w, y + h};
+                bool free = !overlaps(box, clear, 0);
+                for (const Box &other : placed)
+                    free = free && !overlaps(box, other, 30);
+                if (!free)
+                    continue;
+                placed.push_back(box);
+                --count;
+            }
+            for (const Box &box : placed)
+                world.addBox(box);
+            world.place(start);
+        }
+
+        /**
+         * @brief Dead end or U-trap open towards -x in a walled room, the robot facing its back: inside
+         * the dead end near the back, in front of the U-trap mouth.
+         * @return double Back wall x, escaped at s_trapEscape from its middle.
+         */
+        double buildTrap(World &world, bool deadEnd)
+        {
+            double length = deadEnd ? uniform(world, 100, 140) : 50;                   // Side walls
+            double half = deadEnd ? uniform(world, 25, 35) : uniform(world, 28, 38);   // Inner half width
+            double back = deadEnd ? uniform(world, 40, 50) : uniform(world, 60, 80);   // From the robot
+            world.addBox({-200 - s_wall, -180 - s_wall, back + 80 + s_wall, -180}); // Room
+            world.addBox({-200 - s_wall, 180, back + 80 + s_wall, 180 + s_wall});
+            world.addBox({-200 - s_wall, -180, -200, 180});
+            world.addBox({back + 80, -180, back + 80 + s_wall, 180});
+            world.addBox({back, -half - s_wall, back + s_wall, half + s_wall}); // Trap
+            world.addBox({back - length, half, back, half + s_wall});
+            world.addBox({back - length, -half - s_wall, back, -half});
+            world.place({0, uniform(world, -5, 5), uniform(world, -0.3, 0.3)});
+            return back;
+        }
+
+        /**
+         * @brief Closed line with the robot on it, going either way.
+         */
+        void buildTrack(World &world, Track &track, bool &clockwise)
+        {
+            track.radius = uniform(world, 70, 110);
+            track.wave2 = uniform(world, 0, 0.15) * track.radius;
+            track.phase2 = uniform(world, -s_pi, s_pi);
+            track.wave3 = uniform(world, 0, 0.08) * track.radius;
+            track.phase3 = uniform(world, -s_pi, s_pi);
+            world.setTrack(track);
+
+            clockwise = uniform(world, 0, 1) < 0.5;
+            double angle = uniform(world, -s_pi, s_pi), delta = clockwise ? -1e-4 : 1e-4;
+            double x = track.at(angle) * std::cos(angle), y = track.at(angle) * std::sin(angle);
+            double heading = std::atan2(track.at(angle + delta) * std::sin(angle + delta) - y, track.at(angle + delta) * std::cos(angle + delta) - x);
+            heading += uniform(world, -0.08, 0.08);
+            world.place({x - 9 * std::cos(heading), y - 9 * std::sin(heading), heading}); // Middle line sensor on the line
+        }
+
+        /**
+         * @brief Nearly straight line, part of a large closed one, with the robot on it and a box on
+         * the line ahead, facing the robot squarely.
+         * @return double Line angle from the robot to past the box (rad).
+         */
+        double buildDetour(World &world, Track &track, bool &clockwise)
+        {
+            track = {s_detourRadius, 0, 0, 0, 0};
+            world.setTrack(track);
+            clockwise = false;
+            double start = s_pi / 2 + uniform(world, -0.02, 0.02); // Heading about -x
+            double heading = start + s_pi / 2 + uniform(world, -0.08, 0.08);
+            world.place({s_detourRadius * std::cos(start) - 9 * std::cos(heading), s_detourRadius * std::sin(start) - 9 * std::sin(heading), heading});
+            double angle = start + s_detourBox / s_detourRadius;
+            double x = s_detourRadius * std::cos(angle), y = s_detourRadius * std::sin(angle) + uniform(world, -2, 2);
+            world.addBox({x - s_detourSize / 2, y - s_detourSize / 2, x + s_detourSize / 2, y + s_detourSize / 2});
+            return (s_detourBox + s_detourPast) / s_detourRadius;
+        }
+
+        /**
+         * @brief Row of two cars with a gap on a random side of the robot, which starts beside the first one.
+         * @return Box Gap, robot center must end inside.
+         */
+        Box buildParking(World &world)
+        {
+            double side = (uniform(world, 0, 1) < 0.5) ? 1 : -1; // Left or right
+            double offset = uniform(world, 20, 26), length = uniform(world, 45, 70);
+            auto lateral = [&](double x0, double a0, double x1, double a1) {
+                return Box{x0, std::min(side * a0, side * a1), x1, std::max(side * a0, side * a1)};
+            };
+            world.addBox(lateral(-30, offset, 15, offset + 20));                         // First car
+            world.addBox(lateral(15 + length, offset, 60 + length, offset + 20));        // Second car
+            world.addBox(lateral(-60, offset + 40, 120 + length, offset + 40 + s_wall)); // Curb
+            world.place({0, 0, uniform(world, -0.03, 0.03)});
+            return lateral(15, offset - 8, 15 + length, offset + 40); // At least half of the body in
+        }
+
+        /**
+         * @brief One iteration of the main loop in a mode.
+         */
+        template <typename Mode>
+        void loop(Robot &robot, Mode mode)
+        {
+            robot.acquireSensors();
+            (robot.*mode)();
+            mcu().advanceMicros(s_loopTime);
+        }
+    }
+
+    const char *getName(Scenario scenario)
+    {
+        switch (scenario)
+        {
+        case Scenario::OBSTACLE:
+            return "obstacle";
+        case Scenario::LINE:
+            return "line";
+        case Scenario::PARK:
+            return "park";
+        case Scenario::DETOUR:
+            return "detour";
+        case Scenario::REPEAT:
+            return "repeat";
+        case Scenario::REPEAT_CLEAR:
+            return "repeat-clear";
+        case Scenario::DEADEND:
+            return "deadend";
+        case Scenario::UTRAP:
+            return "utrap";
+        default:
+            return "?";
+        }
+    }
+
+    bool parseScenario(const char *name, Scenario &scenario)
+    {
+        for (Scenario candidate : {Scenario::OBSTACLE, Scenario::LINE, Scenario::PARK, Scenario::DETOUR, Scenario::REPEAT, Scenario::REPEAT_CLEAR, Scenario::DEADEND, Scenario::UTRAP})
+        {
+            if (strcmp(name, getName(candidate)) == 0)
+            {
+                scenario = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Run an episode on the MCU of the calling thread.
+     * @param scenario Scenario.
+     * @param index Episode of the scenario.
+     * @param seed Seed of the batch.
+     * @param settings Parameters changed from the defaults.
+     * @return Metrics Result.
+     */
+    Metrics runEpisode(Scenario scenario, unsigned index, uint64_t seed, const std::vector<Setting> &settings)
+    {
+        Scenario layout = (scenario == Scenario::REPEAT_CLEAR) ? Scenario::REPEAT : scenario; // Same rooms, paired runs
+        World world{mix(seed ^ (static_cast<uint64_t>(layout) << 56) ^ mix(index))};
+        Metrics metrics{scenario, index, false, 0, 0, 0, 0, 0, 0, {}};
+        Track track{0, 0, 0, 0, 0};
+        bool clockwise{false};
+        Box gap{0, 0, 0, 0};
+        double goal{2 * s_pi}; // Line progress to complete
+        double lost{s_lineLost};
+        double back{s_lineLost}; // Distance from the line to complete once past the goal
+        double limit{0};
+        double trapBack{0};
+        switch (scenario)
+        {
+        case Scenario::OBSTACLE:
+            buildRoom(world);
+            limit = s_obstacleTime;
+            break;
+        case Scenario::LINE:
+            buildTrack(world, track, clockwise);
+            limit = s_lineTime;
+            break;
+        case Scenario::PARK:
+            gap = buildParking(world);
+            limit = s_parkTime;
+            break;
+        case Scenario::DETOUR:
+            goal = buildDetour(world, track, clockwise);
+            lost = s_detourLost;
+            back = s_detourBack;
+            limit = s_detourTime;
+            break;
+        case Scenario::REPEAT:
+        case Scenario::REPEAT_CLEAR:
+            buildRoom(world);
+            limit = s_repeatRuns * (s_obstacleTime + s_settleTime);
+            break;
+        case Scenario::DEADEND:
+        case Scenario::UTRAP:
+            trapBack = buildTrap(world, scenario == Scenario::DEADEND);
+            limit = s_trapTime;
+            break;
+        }
+        Pose origin = world.getPose();
+
+        Mcu &mcu = sim::mcu();
+        mcu.startEpisode(&world, s_setupTime + limit);
+        std::unique_ptr<Robot> robot;
+        double start = mcu.getTime();
+        try
+        {
+            robot.reset(new Robot());
+            robot->begin();
+            for (const Setting &setting : settings)
+                Parameters::set(setting.param, setting.value);
+            robot->applyParameters();
+            Clock::delay(Constants::serialDelay);
+            robot->restartState(); // Mode selected
+            start = mcu.getTime();
+            switch (scenario)
+            {
+            case Scenario::OBSTACLE:
+                while (world.getDistance() < s_obstacleGoal)
+                    loop(*robot, &Robot::obstacleAvoidanceMode);
+                metrics.completed = true;
+                break;
+            case Scenario::LINE:
+            case Scenario::DETOUR:
+            {
+                auto sensorAngle = [&world]() {
+                    const Pose &pose = world.getPose();
+                    return std::atan2(pose.y + 9 * std::sin(pose.heading), pose.x + 9 * std::cos(pose.heading));
+                };
+                double previous = sensorAngle(), progress{0};
+                while (((std::fabs(progress) < goal) || (world.getLineError() >= back)) && (world.getLineError() < lost))
+                {
+                    loop(*robot, &Robot::lineTrackingMode);
+                    double angle = sensorAngle();
+                    progress += std::remainder(angle - previous, 2 * s_pi);
+                    previous = angle;
+                }
+                metrics.completed = ((clockwise ? -progress : progress) >= goal) && (world.getLineError() < back);
+                break;
+            }
+            case Scenario::PARK:
+            {
+                robot->acquireSensors();
+                robot->parkMode(); // Blocking, returns parked
+                mcu.advanceMicros(s_loopTime);
+                const Pose &pose = world.getPose();
+                metrics.completed = (world.getCollisions() == 0) && (pose.x > gap.x0) && (pose.x < gap.x1) && (pose.y > gap.y0) && (pose.y < gap.y1);
+                break;
+            }
+            case Scenario::REPEAT:
+            case Scenario::REPEAT_CLEAR:
+                for (unsigned run{0}; run < s_repeatRuns; ++run)
+                {
+                    if (run > 0) // Back to the start, as carried there by hand, and the mode selected again
+                    {
+                        robot->restartState();
+                        mcu.advanceMicros(s_settleTime * 1e6);
+                        world.place(origin);
+                        if (scenario == Scenario::REPEAT_CLEAR)
+                            robot->replyMap(true); // {"N":150,"D1":1}
+                    }
+                    double runStart = mcu.getTime(), runDistance = world.getDistance();
+                    metrics.runs.push_back({false, 0, 0});
+                    while (world.getDistance() - runDistance < s_obstacleGoal)
+                    {
+                        loop(*robot, &Robot::obstacleAvoidanceMode);
+                        metrics.runs.back() = {false, mcu.getTime() - runStart, robot->getScans()};
+                    }
+                    metrics.runs.back().completed = true;
+                }
+                metrics.completed = true;
+                break;
+            case Scenario::DEADEND:
+            case Scenario::UTRAP:
+                while (std::hypot(world.getPose().x - trapBack, world.getPose().y) < s_trapEscape)
+                    loop(*robot, &Robot::obstacleAvoidanceMode);
+                metrics.completed = true;
+                break;
+            }
+        }
+        catch (const Timeout &)
+        {
+        }
+        metrics.time = mcu.getTime() - start;
+        metrics.collisions = world.getCollisions();
+        metrics.stops = world.getStops();
+        metrics.pings = world.getPings();
+        metrics.distance = world.getDistance();
+        metrics.scans = robot ? robot->getScans() : 0;
+        ControlTick::end();
+        mcu.endEpisode(); // No deadline for the destructors
+        robot.reset();
+        return metrics;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/**
+ * @file scenario.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Simulated episodes: random surroundings for a robot mode and the metrics of the run.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_SCENARIO_H
+#define SIM_SCENARIO_H
+
+#include <cstdint>
+#include <vector>
+#include "parameters.h"
+
+namespace sim
+{
+    enum class Scenario : unsigned char
+    {
+        OBSTACLE, // Obstacle avoidance in a room with boxes, sometimes a U-trap ahead
+        LINE,     // One lap of a closed line
+        PARK,     // Park in the gap of a row of cars
+        DETOUR,   // Go around a box placed on the line and follow it again
+        REPEAT,   // Obstacle avoidance run several times from the same start, the obstacle grid kept
+        REPEAT_CLEAR, // Same, the obstacle grid cleared before each run
+        DEADEND,  // Obstacle avoidance from inside a dead-end corridor, facing its end
+        UTRAP,    // Obstacle avoidance from the mouth of a U-trap, facing into it
+    };
+
+    /**
+     * @brief Result of a run of a repeated course.
+     */
+    struct Run
+    {
+        bool completed;
+        double time;    // Virtual time of the run (s)
+        unsigned scans; // Robot stops to scan around, Robot::getScans()
+    };
+
+    /**
+     * @brief Result of an episode.
+     */
+    struct Metrics
+    {
+        Scenario scenario;
+        unsigned index;        // Episode of the scenario
+        bool completed;
+        double time;           // Virtual time until completed or given up (s)
+        unsigned collisions;   // Contacts with obstacles
+        unsigned stops;        // Motors stopped after moving
+        unsigned pings;        // Servo sonar pings
+        double distance;       // Distance travelled (cm)
+        unsigned scans;        // Robot stops to scan around in the last run
+        std::vector<Run> runs; // Runs of a repeated course, in order
+    };
+
+    /**
+     * @brief Parameter value set before the episode, as received by Bluetooth.
+     */
+    struct Setting
+    {
+        Param param;
+        unsigned short value;
+    };
+
+    const char *getName(Scenario scenario);
+    bool parseScenario(const char *name, Scenario &scenario);
+    Metrics runEpisode(Scenario scenario, unsigned index, uint64_t seed, const std::vector<Setting> &settings = {});
+}
+
+#endif
\ No newline at end of file
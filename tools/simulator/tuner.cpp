@@ -0,0 +1,359 @@
+/**
+ * @file tuner.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Parameter tuner: evolutionary search of the mode constants on the simulated scenarios.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ *
+ * Usage:
+ *     tuner --budget 600 --episodes 16 --threads 0 --seed 1 --output constants.h --report tuning.txt
+ *
+ * Every candidate runs the same episodes (seed), so the differences come from the parameters only.
+ * The best candidate is checked again on other episodes (seed + 1) and written as a copy of
+ * include/constants.h with the tuned values.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pool.h"
+#include "scenario.h"
+
+namespace
+{
+    /**
+     * @brief Tuned parameter, named as in Constants, and its search range.
+     */
+    struct Knob
+    {
+        Param param;
+        const char *name;
+        unsigned short low, high;
+    };
+
+    constexpr Knob s_knobs[]{
+        {Param::minDistance, "minDistance", 15, 80},
+        {Param::updateInterval, "updateInterval", 100, 500},
+        {Param::crankSpeed, "crankSpeed", 100, 200},
+        {Param::linearSpeed, "linearSpeed", 120, 255},
+        {Param::rotateSpeed, "rotateSpeed", 100, 255},
+        {Param::minDetourDistance, "minDetourDistance", 5, 30},
+        {Param::marginObject, "marginObject", 0, 5},
+    };
+    constexpr size_t s_knobCount{sizeof(s_knobs) / sizeof(s_knobs[0])};
+    constexpr sim::Scenario s_scenarios[]{sim::Scenario::OBSTACLE, sim::Scenario::LINE, sim::Scenario::PARK};
+    constexpr size_t s_parents{4};  // Best candidates kept
+    constexpr size_t s_children{8}; // Candidates per generation
+
+    using Values = std::array<unsigned short, s_knobCount>;
+
+    /**
+     * @brief Candidate result over the scenario set. Lower cost is better.
+     */
+    struct Score
+    {
+        double cost;
+        double lapTime;    // Line episodes completed (s)
+        double collisions; // Per episode
+        double speed;      // Distance over time of all the episodes (cm/s)
+        double completed[3]; // Per scenario (%)
+    };
+
+    struct Candidate
+    {
+        Values values;
+        Score score;
+    };
+
+    struct Options
+    {
+        double budget{600}; // Wall time (s)
+        unsigned episodes{16};
+        unsigned threads{0};
+        unsigned long long seed{1};
+        const char *output{"constants.h"};
+        const char *report{nullptr};
+        const char *constants{FIRMWARE_DIR "/include/constants.h"};
+    };
+
+    void usage()
+    {
+        fprintf(stderr, "Usage: tuner [--budget S] [--episodes N] [--threads N] [--seed N] [--output FILE] [--report FILE] [--constants FILE]\n");
+    }
+
+    bool parse(int argc, char *argv[], Options &options)
+    {
+        for (int i{1}; i < argc; i += 2)
+        {
+            if (i + 1 >= argc)
+                return false;
+            const char *value = argv[i + 1];
+            if (strcmp(argv[i], "--budget") == 0)
+                options.budget = strtod(value, nullptr);
+            else if (strcmp(argv[i], "--episodes") == 0)
+                options.episodes = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            else if (strcmp(argv[i], "--threads") == 0)
+                options.threads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            else if (strcmp(argv[i], "--seed") == 0)
+                options.seed = strtoull(value, nullptr, 10);
+            else if (strcmp(argv[i], "--output") == 0)
+                options.output = value;
+            else if (strcmp(argv[i], "--report") == 0)
+                options.report = value;
+            else if (strcmp(argv[i], "--constants") == 0)
+                options.constants = value;
+            else
+                return false;
+        }
+        return options.episodes > 0;
+    }
+
+    Values defaults()
+    {
+        Values values;
+        for (size_t i{0}; i < s_knobCount; ++i)
+            values[i] = Parameters::getInfo(s_knobs[i].param).defaultValue;
+        return values;
+    }
+
+    std::vector<sim::Setting> settings(const Values &values)
+    {
+        std::vector<sim::Setting> settings;
+        for (size_t i{0}; i < s_knobCount; ++i)
+            settings.push_back({s_knobs[i].param, values[i]});
+        return settings;
+    }
+
+    /**
+     * @brief Cost of an episode: slow, incomplete and colliding runs cost more.
+     */
+    double cost(const sim::Metrics &metrics)
+    {
+        double value = 0.5 * metrics.collisions;
+        switch (metrics.scenario)
+        {
+        case sim::Scenario::OBSTACLE: // 600 cm in about 30 s
+            return value + (metrics.completed ? metrics.time / 60 : 1.5 + (1 - std::min(1.0, metrics.distance / 600)));
+        case sim::Scenario::LINE: // A lap in about 12 s
+            return value + (metrics.completed ? metrics.time / 24 : 1.5);
+        case sim::Scenario::PARK:
+            return value + (metrics.completed ? 0 : 1);
+        default:
+            return value;
+        }
+    }
+
+    /**
+     * @brief Run every candidate on the same episodes, all the jobs in one batch.
+     * @param pool Pool.
+     * @param candidates Candidates, scored.
+     * @param episodes Episodes per scenario.
+     * @param seed Episodes seed.
+     */
+    void evaluate(sim::Pool &pool, std::vector<Candidate> &candidates, unsigned episodes, uint64_t seed)
+    {
+        size_t perCandidate = episodes * 3;
+        std::vector<sim::Metrics> results(candidates.size() * perCandidate);
+        std::vector<std::vector<sim::Setting>> tunings;
+        for (const Candidate &candidate : candidates)
+            tunings.push_back(settings(candidate.values));
+        pool.run(results.size(), [&](size_t job) {
+            size_t episode = job % perCandidate;
+            results[job] = sim::runEpisode(s_scenarios[episode / episodes], static_cast<unsigned>(episode % episodes), seed, tunings[job / perCandidate]);
+        });
+
+        for (size_t c{0}; c < candidates.size(); ++c)
+        {
+            Score &score = candidates[c].score;
+            score = Score{0, 0, 0, 0, {0, 0, 0}};
+            double distance{0}, time{0};
+            unsigned laps{0};
+            for (size_t e{0}; e < perCandidate; ++e)
+            {
+                const sim::Metrics &metrics = results[c * perCandidate + e];
+                score.cost += cost(metrics) / perCandidate;
+                score.collisions += static_cast<double>(metrics.collisions) / perCandidate;
+                distance += metrics.distance;
+                time += metrics.time;
+                if (!metrics.completed)
+                    continue;
+                score.completed[static_cast<size_t>(metrics.scenario)] += 100.0 / episodes;
+                if (metrics.scenario == sim::Scenario::LINE)
+                {
+                    score.lapTime += metrics.time;
+                    ++laps;
+                }
+            }
+            score.lapTime = laps ? score.lapTime / laps : NAN;
+            score.speed = (time > 0) ? distance / time : 0;
+        }
+    }
+
+    /**
+     * @brief Child of a candidate: gaussian steps of a part of each range, some of the genes reset at random.
+     */
+    Values mutate(const Values &parent, double sigma, std::mt19937_64 &random)
+    {
+        Values child = parent;
+        std::normal_distribution<double> step{0, sigma};
+        std::uniform_real_distribution<double> unit{0, 1};
+        for (size_t i{0}; i < s_knobCount; ++i)
+        {
+            const Knob &knob = s_knobs[i];
+            double span = knob.high - knob.low;
+            double value = (unit(random) < 0.1) ? knob.low + unit(random) * span : parent[i] + step(random) * span;
+            child[i] = static_cast<unsigned short>(std::lround(std::min<double>(knob.high, std::max<double>(knob.low, value))));
+        }
+        return child;
+    }
+
+    Values randomValues(std::mt19937_64 &random)
+    {
+        Values values;
+        for (size_t i{0}; i < s_knobCount; ++i)
+            values[i] = std::uniform_int_distribution<unsigned short>{s_knobs[i].low, s_knobs[i].high}(random);
+        return values;
+    }
+
+    /**
+     * @brief Copy of the constants header with the tuned values.
+     */
+    bool writeHeader(const Options &options, const Values &current, const Values &tuned, unsigned generations)
+    {
+        std::ifstream input{options.constants};
+        if (!input)
+            return false;
+        std::stringstream buffer;
+        buffer << input.rdbuf();
+        std::string text = buffer.str();
+        std::string changes;
+        for (size_t i{0}; i < s_knobCount; ++i)
+        {
+            std::regex definition{std::string{R"((constexpr [a-z ]+ )"} + s_knobs[i].name + R"(\{)[0-9]+\})"};
+            if (!std::regex_search(text, definition))
+                return false;
+            text = std::regex_replace(text, definition, "$01" + std::to_string(tuned[i]) + "}", std::regex_constants::format_first_only);
+            if (tuned[i] != current[i])
+                changes += std::string{changes.empty() ? "" : ", "} + s_knobs[i].name + " " + std::to_string(current[i]) + " -> " + std::to_string(tuned[i]);
+        }
+        char note[160];
+        snprintf(note, sizeof(note), "// Tuned by tools/simulator/tuner (seed %llu, %u episodes per scenario, %u generations): ", options.seed, options.episodes, generations);
+        size_t guard = text.find("#ifndef CONSTANTS_H");
+        if (guard == std::string::npos)
+            return false;
+        text.insert(guard, note + (changes.empty() ? std::string{"no change"} : changes) + "\n\n");
+        std::ofstream output{options.output};
+        output << text;
+        return static_cast<bool>(output);
+    }
+
+    void printScores(FILE *file, const char *name, const Score &a, const Score &b, const Score &c, const Score &d)
+    {
+        fprintf(file, "%-26s%10s%10s%12s%10s\n", name, "current", "tuned", "current", "tuned");
+        fprintf(file, "%-26s%10.3f%10.3f%12.3f%10.3f\n", "cost", a.cost, b.cost, c.cost, d.cost);
+        fprintf(file, "%-26s%10.2f%10.2f%12.2f%10.2f\n", "lap time (s)", a.lapTime, b.lapTime, c.lapTime, d.lapTime);
+        fprintf(file, "%-26s%10.2f%10.2f%12.2f%10.2f\n", "collisions per episode", a.collisions, b.collisions, c.collisions, d.collisions);
+        fprintf(file, "%-26s%10.1f%10.1f%12.1f%10.1f\n", "average speed (cm/s)", a.speed, b.speed, c.speed, d.speed);
+        for (size_t s{0}; s < 3; ++s)
+        {
+            std::string label = std::string{sim::getName(s_scenarios[s])} + " completed (%)";
+            fprintf(file, "%-26s%10.1f%10.1f%12.1f%10.1f\n", label.c_str(), a.completed[s], b.completed[s], c.completed[s], d.completed[s]);
+        }
+    }
+
+    void report(FILE *file, const Options &options, const Candidate &current, const Candidate &tuned, const Candidate &currentCheck,
+                const Candidate &tunedCheck, unsigned generations, size_t evaluated, double wall)
+    {
+        fprintf(file, "%zu candidates in %u generations, %u episodes per scenario, %.0f s\n\n", evaluated, generations, options.episodes, wall);
+        fprintf(file, "%-26s%10s%10s\n", "parameter", "current", "tuned");
+        for (size_t i{0}; i < s_knobCount; ++i)
+            fprintf(file, "%-26s%10u%10u\n", s_knobs[i].name, current.values[i], tuned.values[i]);
+        fprintf(file, "\n%-26s%20s%22s\n", "", "search episodes", "check episodes");
+        printScores(file, "", current.score, tuned.score, currentCheck.score, tunedCheck.score);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    sim::Pool pool{threads};
+    std::mt19937_64 random{options.seed};
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    // Generation 0: current values and random ones
+    std::vector<Candidate> population{{defaults(), {}}};
+    while (population.size() < s_children)
+        population.push_back({randomValues(random), {}});
+    evaluate(pool, population, options.episodes, options.seed);
+    Candidate current = population.front();
+    size_t evaluated = population.size();
+    unsigned generations{1};
+    double generationTime = elapsed();
+
+    // (parents + children) evolution, the step shrinking with the generations
+    while (elapsed() + generationTime < options.budget)
+    {
+        double generationStart = elapsed();
+        std::sort(population.begin(), population.end(), [](const Candidate &a, const Candidate &b) { return a.score.cost < b.score.cost; });
+        population.resize(std::min(population.size(), s_parents));
+        double sigma = std::max(0.03, 0.2 * std::pow(0.85, generations));
+        std::vector<Candidate> children;
+        for (size_t i{0}; i < s_children; ++i)
+        {
+            Values values = (i % 4 == 3) ? randomValues(random) : mutate(population[i % population.size()].values, sigma, random);
+            children.push_back({values, {}});
+        }
+        evaluate(pool, children, options.episodes, options.seed);
+        population.insert(population.end(), children.begin(), children.end());
+        evaluated += children.size();
+        ++generations;
+        generationTime = elapsed() - generationStart;
+        const Candidate &best = *std::min_element(population.begin(), population.end(), [](const Candidate &a, const Candidate &b) { return a.score.cost < b.score.cost; });
+        printf("generation %u: best cost %.3f (current %.3f), %.0f s\n", generations, best.score.cost, current.score.cost, elapsed());
+        fflush(stdout);
+    }
+    Candidate tuned = *std::min_element(population.begin(), population.end(), [](const Candidate &a, const Candidate &b) { return a.score.cost < b.score.cost; });
+
+    // Same comparison on episodes not used by the search
+    std::vector<Candidate> check{current, tuned};
+    evaluate(pool, check, options.episodes, options.seed + 1);
+
+    report(stdout, options, current, tuned, check[0], check[1], generations, evaluated, elapsed());
+    if (options.report)
+    {
+        FILE *file = fopen(options.report, "w");
+        if (!file)
+        {
+            fprintf(stderr, "tuner: can not write %s\n", options.report);
+            return 1;
+        }
+        report(file, options, current, tuned, check[0], check[1], generations, evaluated, elapsed());
+        fclose(file);
+    }
+    if (!writeHeader(options, current.values, tuned.values, generations))
+    {
+        fprintf(stderr, "tuner: can not write %s from %s\n", options.output, options.constants);
+        return 1;
+    }
+    printf("Constants written to %s\n", options.output);
+    return 0;
+}
\ No newline at end of file
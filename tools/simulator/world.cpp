@@ -0,0 +1,357 @@
+/**
+ * @file world.cpp
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Simulated robot and surroundings: differential drive, servo sonar, line sensors and battery.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "world.h"
+
+namespace sim
+{
+    namespace
+    {
+        constexpr double s_pi{3.14159265358979323846};
+        constexpr double s_fullSpeed{60};       // Wheel speed @ 255 and nominal battery (cm/s)
+        constexpr double s_nominal{8.0};        // Battery voltage of s_fullSpeed (V)
+        constexpr double s_halfLength{13};      // Body around the wheel axle (cm)
+        constexpr double s_halfWidth{8};
+        constexpr double s_sonarOffset{10};     // Servo axis in front of the wheel axle (cm)
+        constexpr double s_lineOffset{9};       // Line sensors in front of the wheel axle (cm)
+        constexpr double s_lineSpacing{1.5};    // Between the line sensors (cm)
+        constexpr double s_servoRate{450};      // Servo slew rate (deg/s)
+        constexpr double s_beam{10 * s_pi / 180};     // Sonar beam half width
+        constexpr double s_grazing{65 * s_pi / 180};  // Incidence from which the echo is reflected away
+        constexpr double s_sonarRange{400};     // cm
+        constexpr double s_soundTime{1 / 0.01715}; // Echo time per cm (us)
+        constexpr double s_countVoltage{0.03744};   // Battery voltage per ADC count (V)
+        constexpr double s_stopTime{0.02};      // Motors stopped for longer than this is a stop (s)
+    }
+
+    /**
+     * @brief Radius of the line.
+     * @param angle Polar angle (rad).
+     * @return double Radius (cm).
+     */
+    double Track::at(double angle) const
+    {
+        return radius + wave2 * std::cos(2 * angle + phase2) + wave3 * std::cos(3 * angle + phase3);
+    }
+
+    /**
+     * @brief Construct a new World::World object: empty floor, random wheels, servo and battery.
+     * @param seed Random seed of the episode.
+     */
+    World::World(uint64_t seed)
+        : m_random{seed}, m_time{0}, m_pose{0, 0, 0}, m_leftSpeed{0}, m_rightSpeed{0}, m_leftDuty{0}, m_rightDuty{0},
+          m_hasTrack{false}, m_track{0, 0, 0, 0, 0}, m_lineSize{0}, m_contact{false}, m_stoppedTime{0}, m_moving{false},
+          m_distance{0}, m_collisions{0}, m_stops{0}, m_pings{0}
+    {
+        std::uniform_real_distribution<double> unit{-1, 1};
+        m_leftGain = 1 + 0.05 * unit(m_random);
+        m_rightGain = 1 + 0.05 * unit(m_random);
+        m_stall = 75 + 15 * unit(m_random);
+        m_voltage = 7.9 + 0.4 * unit(m_random);
+        m_servo0 = 500 + 30 * unit(m_random);
+        m_servo180 = 2400 + 30 * unit(m_random);
+        m_servoAngle = m_servoTarget = 90;
+    }
+
+    void World::addBox(const Box &box)
+    {
+        m_boxes.push_back(box);
+    }
+
+    /**
+     * @brief Draw the line on the floor raster.
+     * @param track Line.
+     */
+    void World::setTrack(const Track &track)
+    {
+        m_hasTrack = true;
+        m_track = track;
+        double extent = track.radius + std::fabs(track.wave2) + std::fabs(track.wave3) + 10;
+        m_lineSize = static_cast<int>(2 * extent / s_cell) + 1;
+        m_line.assign(static_cast<size_t>(m_lineSize) * m_lineSize, 0);
+        int reach = static_cast<int>(std::ceil(s_tape / 2 / s_cell));
+        double step = 0.1 / (track.radius + std::fabs(track.wave2) + std::fabs(track.wave3)); // About 0.1 cm
+        for (double angle{0}; angle < 2 * s_pi; angle += step)
+        {
+            double r = track.at(angle);
+            double x = r * std::cos(angle), y = r * std::sin(angle);
+            int column = static_cast<int>(std::floor(x / s_cell)) + m_lineSize / 2;
+            int row = static_cast<int>(std::floor(y / s_cell)) + m_lineSize / 2;
+            for (int j{row - reach}; j <= row + reach; ++j)
+            {
+                for (int i{column - reach}; i <= column + reach; ++i)
+                {
+                    if ((i < 0) || (j < 0) || (i >= m_lineSize) || (j >= m_lineSize))
+                        continue;
+                    double cx = (i - m_lineSize / 2 + 0.5) * s_cell, cy = (j - m_lineSize / 2 + 0.5) * s_cell;
+                    if (std::hypot(cx - x, cy - y) <= s_tape / 2)
+                        m_line[static_cast<size_t>(j) * m_lineSize + i] = 1;
+                }
+            }
+        }
+    }
+
+    void World::place(const Pose &pose)
+    {
+        m_pose = pose;
+    }
+
+    std::mt19937_64 &World::random()
+    {
+        return m_random;
+    }
+
+    const Pose &World::getPose() const
+    {
+        return m_pose;
+    }
+
+    double World::getDistance() const
+    {
+        return m_distance;
+    }
+
+    unsigned World::getCollisions() const
+    {
+        return m_collisions;
+    }
+
+    unsigned World::getStops() const
+    {
+        return m_stops;
+    }
+
+    unsigned World::getPings() const
+    {
+        return m_pings;
+    }
+
+    bool World::isInContact() const
+    {
+        return m_contact;
+    }
+
+    /**
+     * @brief Distance from the middle line sensor to the line, measured along the radius.
+     * @return double Distance (cm), infinite without line.
+     */
+    double World::getLineError() const
+    {
+        if (!m_hasTrack)
+            return std::numeric_limits<double>::infinity();
+        double x = m_pose.x + s_lineOffset * std::cos(m_pose.heading);
+        double y = m_pose.y + s_lineOffset * std::sin(m_pose.heading);
+        return std::fabs(std::hypot(x, y) - m_track.at(std::atan2(y, x)));
+    }
+
+    double World::gaussian(double sigma)
+    {
+        return std::normal_distribution<double>{0, sigma}(m_random);
+    }
+
+    /**
+     * @brief Check the body against the boxes, separating axis test.
+     * @param pose Pose.
+     * @return true Overlapping an obstacle.
+     */
+    bool World::collides(const Pose &pose) const
+    {
+        double c = std::cos(pose.heading), s = std::sin(pose.heading);
+        double extentX = s_halfLength * std::fabs(c) + s_halfWidth * std::fabs(s);
+        double extentY = s_halfLength * std::fabs(s) + s_halfWidth * std::fabs(c);
+        for (const Box &box : m_boxes)
+        {
+            if ((pose.x + extentX <= box.x0) || (pose.x - extentX >= box.x1) || (pose.y + extentY <= box.y0) || (pose.y - extentY >= box.y1))
+                continue;
+            double cx = (box.x0 + box.x1) / 2 - pose.x, cy = (box.y0 + box.y1) / 2 - pose.y;
+            double hx = (box.x1 - box.x0) / 2, hy = (box.y1 - box.y0) / 2;
+            double along = cx * c + cy * s, across = -cx * s + cy * c; // Box center in the body axes
+            if (std::fabs(along) >= s_halfLength + hx * std::fabs(c) + hy * std::fabs(s))
+                continue;
+            if (std::fabs(across) >= s_halfWidth + hx * std::fabs(s) + hy * std::fabs(c))
+                continue;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Cast a sonar ray against the boxes.
+     * @param x Origin (cm).
+     * @param y Origin (cm).
+     * @param angle Direction (rad).
+     * @return double Distance to the first surface reflecting back (cm), infinite for none.
+     */
+    double World::castRay(double x, double y, double angle) const
+    {
+        double dx = std::cos(angle), dy = std::sin(angle);
+        double best = std::numeric_limits<double>::infinity();
+        for (const Box &box : m_boxes)
+        {
+            double near{-std::numeric_limits<double>::infinity()}, far{std::numeric_limits<double>::infinity()};
+            bool xFace{true}; // Face hit: vertical (normal along x) or horizontal
+            if (std::fabs(dx) < 1e-12)
+            {
+                if ((x <= box.x0) || (x >= box.x1))
+                    continue;
+            }
+            else
+            {
+                double t0 = (box.x0 - x) / dx, t1 = (box.x1 - x) / dx;
+                near = std::min(t0, t1);
+                far = std::max(t0, t1);
+            }
+            if (std::fabs(dy) < 1e-12)
+            {
+                if ((y <= box.y0) || (y >= box.y1))
+                    continue;
+            }
+            else
+            {
+                double t0 = (box.y0 - y) / dy, t1 = (box.y1 - y) / dy;
+                if (std::min(t0, t1) > near)
+                {
+                    near = std::min(t0, t1);
+                    xFace = false;
+                }
+                far = std::min(far, std::max(t0, t1));
+            }
+            if ((near > far) || (far < 0))
+                continue;
+            if (near < 0) // Inside the box, pressed against it
+            {
+                best = std::min(best, 2.0);
+                continue;
+            }
+            double incidence = std::acos(std::fabs(xFace ? dx : dy));
+            if ((incidence < s_grazing) && (near < best))
+                best = near;
+        }
+        return best;
+    }
+
+    /**
+     * @brief Run the physics until the time.
+     * @param time Time (s).
+     */
+    void World::update(double time)
+    {
+        while (m_time + s_step <= time)
+        {
+            step();
+            m_time += s_step;
+        }
+    }
+
+    void World::step()
+    {
+        double scale = s_fullSpeed / 255 * m_voltage / s_nominal;
+        double leftTarget = (std::abs(m_leftDuty) < m_stall) ? 0 : m_leftDuty * scale * m_leftGain;
+        double rightTarget = (std::abs(m_rightDuty) < m_stall) ? 0 : m_rightDuty * scale * m_rightGain;
+        m_leftSpeed += (leftTarget - m_leftSpeed) * s_step / s_lag;
+        m_rightSpeed += (rightTarget - m_rightSpeed) * s_step / s_lag;
+        double slip = 1 + gaussian(0.02);
+        double linear = (m_leftSpeed + m_rightSpeed) / 2 * slip;
+        double angular = (m_rightSpeed - m_leftSpeed) / s_track * slip;
+
+        Pose next{m_pose.x + linear * std::cos(m_pose.heading) * s_step, m_pose.y + linear * std::sin(m_pose.heading) * s_step,
+                  m_pose.heading + angular * s_step};
+        if (collides(next))
+        {
+            if (!m_contact)
+                ++m_collisions;
+            m_contact = true;
+        }
+        else
+        {
+            m_distance += std::hypot(next.x - m_pose.x, next.y - m_pose.y);
+            m_pose = next;
+            m_contact = false;
+        }
+
+        if ((m_leftDuty == 0) && (m_rightDuty == 0))
+        {
+            m_stoppedTime += s_step;
+            if (m_moving && (m_stoppedTime >= s_stopTime))
+            {
+                ++m_stops;
+                m_moving = false;
+            }
+        }
+        else
+        {
+            m_stoppedTime = 0;
+            m_moving = true;
+        }
+
+        double error = m_servoTarget - m_servoAngle;
+        double slew = s_servoRate * s_step;
+        m_servoAngle += (std::fabs(error) <= slew) ? error : std::copysign(slew, error);
+    }
+
+    void World::setMotors(short left, short right)
+    {
+        m_leftDuty = left;
+        m_rightDuty = right;
+    }
+
+    void World::setServo(unsigned short pulse)
+    {
+        m_servoTarget = std::min(180.0, std::max(0.0, (pulse - m_servo0) * 180 / (m_servo180 - m_servo0)));
+    }
+
+    /**
+     * @brief Ping the servo sonar: nearest echo of a few rays across the beam.
+     * @return unsigned long Echo pulse (us), 0 for none.
+     */
+    unsigned long World::trigger()
+    {
+        ++m_pings;
+        double x = m_pose.x + s_sonarOffset * std::cos(m_pose.heading);
+        double y = m_pose.y + s_sonarOffset * std::sin(m_pose.heading);
+        double direction = m_pose.heading + (m_servoAngle - 90) * s_pi / 180; // Servo 0 deg looks right
+        double distance = std::numeric_limits<double>::infinity();
+        for (int ray{-2}; ray <= 2; ++ray)
+            distance = std::min(distance, castRay(x, y, direction + ray * s_beam / 2));
+        if (std::uniform_real_distribution<double>{0, 1}(m_random) < 0.01) // Lost echo
+            return 0;
+        if (distance > s_sonarRange)
+            return 0;
+        distance = std::max(2.0, distance + gaussian(0.3 + 0.01 * distance));
+        return static_cast<unsigned long>(distance * s_soundTime);
+    }
+
+    /**
+     * @brief Line sensor over the line.
+     * @param sensor 0 left, 1 middle, 2 right.
+     * @return true Over the line.
+     */
+    bool World::isOnLine(unsigned char sensor)
+    {
+        if (!m_hasTrack)
+            return false;
+        double lateral = (1 - sensor) * s_lineSpacing; // Left is positive
+        double c = std::cos(m_pose.heading), s = std::sin(m_pose.heading);
+        double x = m_pose.x + s_lineOffset * c - lateral * s;
+        double y = m_pose.y + s_lineOffset * s + lateral * c;
+        int column = static_cast<int>(std::floor(x / s_cell)) + m_lineSize / 2;
+        int row = static_cast<int>(std::floor(y / s_cell)) + m_lineSize / 2;
+        if ((column < 0) || (row < 0) || (column >= m_lineSize) || (row >= m_lineSize))
+            return false;
+        return m_line[static_cast<size_t>(row) * m_lineSize + column];
+    }
+
+    unsigned short World::readBattery()
+    {
+        return static_cast<unsigned short>(m_voltage / s_countVoltage + gaussian(0.5) + 0.5);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/**
+ * @file world.h
+ * @author José Ángel Sánchez (https://github.com/gelanchez)
+ * @brief Simulated robot and surroundings: differential drive, servo sonar, line sensors and battery.
+ * @version 1.0.0
+ * @date 2026-10-19
+ * @copyright GPL-3.0
+ */
+
+#ifndef SIM_WORLD_H
+#define SIM_WORLD_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "mcu.h"
+
+namespace sim
+{
+    /**
+     * @brief Axis-aligned obstacle or wall (cm).
+     */
+    struct Box
+    {
+        double x0, y0, x1, y1;
+    };
+
+    /**
+     * @brief Robot pose: wheel axle center (cm) and heading (rad, counterclockwise from x).
+     */
+    struct Pose
+    {
+        double x, y, heading;
+    };
+
+    /**
+     * @brief Closed line around the origin, r(a) = radius + wave2 cos(2a + phase2) + wave3 cos(3a + phase3).
+     */
+    struct Track
+    {
+        double radius, wave2, phase2, wave3, phase3;
+
+        double at(double angle) const;
+    };
+
+    class World : public Hardware
+    {
+    private:
+        static constexpr double s_step{0.001};       // Physics step (s)
+        static constexpr double s_track{29.2};       // Effective wheel track, rotate90Time @ rotateSpeed (cm)
+        static constexpr double s_lag{0.08};         // Wheel speed time constant (s)
+        static constexpr double s_cell{0.5};         // Line raster (cm)
+        static constexpr double s_tape{1.9};         // Line width (cm)
+
+        std::mt19937_64 m_random;
+        double m_time;                // Physics time (s)
+        Pose m_pose;
+        double m_leftSpeed, m_rightSpeed; // Wheel speeds (cm/s)
+        short m_leftDuty, m_rightDuty;
+        double m_leftGain, m_rightGain;   // Wheel speed per nominal speed
+        double m_stall;                    // Duty below which the wheels do not move
+        double m_voltage;                  // Battery (V)
+        double m_servoAngle, m_servoTarget; // Physical servo position (deg)
+        double m_servo0, m_servo180;       // Pulse of the physical 0 and 180 deg (us)
+        std::vector<Box> m_boxes;
+        bool m_hasTrack;
+        Track m_track;
+        std::vector<uint8_t> m_line;       // Line raster
+        int m_lineSize;                    // Raster cells per side, centered at the origin
+        bool m_contact;
+        double m_stoppedTime;              // Time with the motors stopped (s)
+        bool m_moving;
+        double m_distance;                 // Distance travelled (cm)
+        unsigned m_collisions, m_stops, m_pings;
+
+        void step();
+        bool collides(const Pose &pose) const;
+        double castRay(double x, double y, double angle) const;
+        double gaussian(double sigma);
+
+    public:
+        explicit World(uint64_t seed);
+        void addBox(const Box &box);
+        void setTrack(const Track &track);
+        void place(const Pose &pose);
+        std::mt19937_64 &random();
+
+        const Pose &getPose() const;
+        double getDistance() const;
+        unsigned getCollisions() const;
+        unsigned getStops() const;
+        unsigned getPings() const;
+        bool isInContact() const;
+        double getLineError() const;
+
+        void update(double time) override;
+        void setMotors(short left, short right) override;
+        void setServo(unsigned short pulse) override;
+        unsigned long trigger() override;
+        bool isOnLine(unsigned char sensor) override;
+        unsigned short readBattery() override;
+    };
+}
+
+#endif
\ No newline at end of file